@@ -0,0 +1,418 @@
+#pragma once
+
+//////////////////////////////////////////////////////
+// Resource allocation for arbitrary conflict graphs (the drinking philosophers generalization).
+//
+// Every job needs a fixed set of resources (bottles) and must hold all of them at once to run.
+// Two jobs conflict when their sets overlap. The dining philosophers ring is the special case
+// where job i needs resources i and i+1.
+//
+// Sets are granted with ordered acquisition: each job keeps its resources sorted and waits on
+// them in ascending order. Since every job climbs the same global order, no cycle of jobs can
+// each be holding a resource the next one wants, so the engine cannot deadlock.
+//
+// Config file format, one directive per line, # starts a comment:
+//     resources R        number of resources (optional, otherwise inferred from the largest index)
+//     job r1 r2 ...      a new job that needs resources r1, r2, ...
+//     edge a b           jobs a and b (defined by earlier job lines) conflict. Adds a new resource that only
+//                        jobs a and b need.
+// Resource indices are below R if it was declared, and below CG_MAX_RESOURCES either way.
+//////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <semaphore.h>
+
+#define CG_LINE 4096
+#define CG_MAX_RESOURCES 65536 //Largest resource count a config file may use, so a typo can't ask for gigabytes of semaphores
+
+unsigned int prng();
+
+typedef struct Job {
+    int count;
+    int* res; //Sorted, no duplicates
+}Job;
+
+typedef struct Conflict_graph {
+    int resources;
+    int jobs;
+    Job* job;
+    sem_t* locks; //One binary semaphore per resource
+}Conflict_graph;
+
+/*************************************************
+ * Function: cg_add_job
+ * Description: Appends an empty job to the graph
+ * Params: Conflict_graph pointer
+ * Returns: Index of the new job
+ * Pre-conditions: None
+ * Post-conditions: Job array has grown by one
+ * **********************************************/
+int cg_add_job(Conflict_graph* cg)
+{
+    cg->job = (Job*)realloc(cg->job, sizeof(Job)*(cg->jobs + 1));
+    cg->job[cg->jobs].count = 0;
+    cg->job[cg->jobs].res = NULL;
+    return cg->jobs++;
+}
+
+/*************************************************
+ * Function: cg_add_resource
+ * Description: Adds a resource to a job's set
+ * Params: Conflict_graph pointer, job index, resource index
+ * Returns: None
+ * Pre-conditions: Job exists
+ * Post-conditions: Resource is in the job's set (possibly twice until cg_finalize)
+ * **********************************************/
+void cg_add_resource(Conflict_graph* cg, int job, int res)
+{
+    Job* j = &cg->job[job];
+    j->res = (int*)realloc(j->res, sizeof(int)*(j->count + 1));
+    j->res[j->count++] = res;
+    if(res >= cg->resources)
+        cg->resources = res + 1;
+}
+
+/*************************************************
+ * Function: cg_compare
+ * Description: qsort comparator for resource indices
+ * Params: Two int pointers
+ * Returns: Negative, zero or positive like strcmp
+ * Pre-conditions: None
+ * Post-conditions: None
+ * **********************************************/
+int cg_compare(const void* a, const void* b)
+{
+    return *(const int*)a - *(const int*)b;
+}
+
+/*************************************************
+ * Function: cg_finalize
+ * Description: Sorts and dedups every job's set into the global acquisition order and creates one semaphore per resource
+ * Params: Conflict_graph pointer
+ * Returns: 1, or 0 after printing the problem if the semaphores could not be allocated
+ * Pre-conditions: All jobs and resources have been added
+ * Post-conditions: Graph is ready for cg_acquire and cg_release
+ * **********************************************/
+int cg_finalize(Conflict_graph* cg)
+{
+    int i, k, n;
+    for(i = 0; i < cg->jobs; i++)
+    {
+        Job* j = &cg->job[i];
+        qsort(j->res, j->count, sizeof(int), cg_compare);
+        for(k = 0, n = 0; k < j->count; k++)
+        {
+            if(n == 0 || j->res[n-1] != j->res[k])
+                j->res[n++] = j->res[k];
+        }
+        j->count = n;
+    }
+
+    cg->locks = (sem_t*)malloc(sizeof(sem_t)*(cg->resources > 0 ? cg->resources : 1));
+    if(cg->locks == NULL)
+    {
+        printf("Out of memory for %d resources\n", cg->resources);
+        return 0;
+    }
+    for(i = 0; i < cg->resources; i++)
+        sem_init(&cg->locks[i], 0, 1);
+    return 1;
+}
+
+/*************************************************
+ * Function: cg_new
+ * Description: Allocates an empty conflict graph
+ * Params: None
+ * Returns: Conflict_graph pointer
+ * Pre-conditions: None
+ * Post-conditions: Graph has no jobs and no resources
+ * **********************************************/
+Conflict_graph* cg_new()
+{
+    Conflict_graph* cg = (Conflict_graph*)malloc(sizeof(Conflict_graph));
+    cg->resources = 0;
+    cg->jobs = 0;
+    cg->job = NULL;
+    cg->locks = NULL;
+    return cg;
+}
+
+/*************************************************
+ * Function: cg_free
+ * Description: Frees a conflict graph, finalized or not
+ * Params: Conflict_graph pointer
+ * Returns: None
+ * Pre-conditions: No job holds any resource
+ * Post-conditions: Pointer is invalid
+ * **********************************************/
+void cg_free(Conflict_graph* cg)
+{
+    int i;
+    for(i = 0; i < cg->jobs; i++)
+        free(cg->job[i].res);
+    free(cg->job);
+    if(cg->locks != NULL)
+    {
+        for(i = 0; i < cg->resources; i++)
+            sem_destroy(&cg->locks[i]);
+        free(cg->locks);
+    }
+    free(cg);
+}
+
+/*************************************************
+ * Function: cg_number
+ * Description: Parses a whole token as a decimal number in a range
+ * Params: Token (may be NULL), largest allowed value, where to store the number
+ * Returns: 1 if every character of the token parsed and the value is between 0 and max, 0 otherwise
+ * Pre-conditions: None
+ * Post-conditions: *out is set on success
+ * **********************************************/
+int cg_number(const char* token, long max, int* out)
+{
+    if(token == NULL)
+        return 0;
+    char* end;
+    long value = strtol(token, &end, 10);
+    if(end == token || *end != '\0' || value < 0 || value > max)
+        return 0;
+    *out = (int)value;
+    return 1;
+}
+
+/*************************************************
+ * Function: cg_load
+ * Description: Reads per job resource sets and conflict edges from a config file (format at the top of this file)
+ * Params: Path to the config file
+ * Returns: Finalized Conflict_graph pointer, or NULL after printing the problem if the file can't be read or is malformed
+ * Pre-conditions: None
+ * Post-conditions: None
+ * **********************************************/
+Conflict_graph* cg_load(const char* path)
+{
+    FILE* f = fopen(path, "r");
+    if(f == NULL)
+    {
+        printf("Could not open %s\n", path);
+        return NULL;
+    }
+
+    Conflict_graph* cg = cg_new();
+    int declared = -1;
+    int line_no = 0;
+    int edges = 0;
+    int* edge = NULL; //Pairs of conflicting jobs, given their own resources once every job set is known
+    char line[CG_LINE];
+    while(fgets(line, CG_LINE, f) != NULL)
+    {
+        line_no++;
+        char* hash = strchr(line, '#');
+        if(hash != NULL)
+            *hash = '\0';
+
+        char* word = strtok(line, " \t\r\n");
+        if(word == NULL)
+            continue;
+
+        int ok = 1;
+        int a, b;
+        if(strcmp(word, "resources") == 0)
+            ok = cg_number(strtok(NULL, " \t\r\n"), CG_MAX_RESOURCES, &declared) && declared > 0;
+        else if(strcmp(word, "job") == 0)
+        {
+            int job = cg_add_job(cg);
+            char* arg;
+            while(ok && (arg = strtok(NULL, " \t\r\n")) != NULL)
+            {
+                ok = cg_number(arg, (declared > 0 ? declared : CG_MAX_RESOURCES) - 1, &a);
+                if(ok)
+                    cg_add_resource(cg, job, a);
+            }
+        }
+        else if(strcmp(word, "edge") == 0)
+        {
+            //Both jobs must already exist, or a large index would quietly create that many jobs
+            ok = cg_number(strtok(NULL, " \t\r\n"), cg->jobs - 1, &a) && cg_number(strtok(NULL, " \t\r\n"), cg->jobs - 1, &b)
+                && a != b;
+            if(ok)
+            {
+                edge = (int*)realloc(edge, sizeof(int)*2*(edges + 1));
+                edge[2*edges] = a;
+                edge[2*edges + 1] = b;
+                edges++;
+            }
+        }
+        else
+            ok = 0;
+
+        if(!ok)
+        {
+            printf("%s:%d: can't parse line\n", path, line_no);
+            fclose(f);
+            free(edge);
+            cg_free(cg);
+            return NULL;
+        }
+    }
+    fclose(f);
+
+    if(declared > 0 && cg->resources > declared)
+    {
+        printf("%s: a job uses resource %d but only %d resources are declared\n", path, cg->resources - 1, declared);
+        free(edge);
+        cg_free(cg);
+        return NULL;
+    }
+    if(declared > cg->resources)
+        cg->resources = declared;
+
+    //Every edge gets a fresh resource numbered after the declared ones
+    int e; for(e = 0; e < edges; e++)
+    {
+        int res = cg->resources;
+        cg_add_resource(cg, edge[2*e], res);
+        cg_add_resource(cg, edge[2*e + 1], res);
+    }
+    free(edge);
+
+    if(cg->jobs < 2)
+    {
+        printf("%s: needs at least 2 jobs\n", path);
+        cg_free(cg);
+        return NULL;
+    }
+
+    if(!cg_finalize(cg))
+    {
+        cg_free(cg);
+        return NULL;
+    }
+    return cg;
+}
+
+/*************************************************
+ * Function: cg_ring
+ * Description: Builds the classic dining philosophers table as a conflict graph, job i needs resources i and i+1
+ * Params: Number of seats
+ * Returns: Finalized Conflict_graph pointer, or NULL if it could not be allocated
+ * Pre-conditions: seats is at least 2
+ * Post-conditions: None
+ * **********************************************/
+Conflict_graph* cg_ring(int seats)
+{
+    Conflict_graph* cg = cg_new();
+    int i; for(i = 0; i < seats; i++)
+    {
+        cg_add_job(cg);
+        cg_add_resource(cg, i, i);
+        cg_add_resource(cg, i, (i + 1) % seats);
+    }
+    if(!cg_finalize(cg))
+    {
+        cg_free(cg);
+        return NULL;
+    }
+    return cg;
+}
+
+/*************************************************
+ * Function: cg_random
+ * Description: Builds a random conflict graph where every job needs per_job distinct resources picked uniformly from the pool
+ * Params: Number of jobs, number of resources, resources per job
+ * Returns: Finalized Conflict_graph pointer, or NULL if it could not be allocated
+ * Pre-conditions: per_job is between 1 and resources, prng is seeded
+ * Post-conditions: None
+ * **********************************************/
+Conflict_graph* cg_random(int jobs, int resources, int per_job)
+{
+    Conflict_graph* cg = cg_new();
+    cg->resources = resources;
+    int* pool = (int*)malloc(sizeof(int)*resources);
+    int i, k;
+    for(i = 0; i < jobs; i++)
+    {
+        cg_add_job(cg);
+        for(k = 0; k < resources; k++)
+            pool[k] = k;
+        for(k = 0; k < per_job; k++) //Partial Fisher-Yates shuffle
+        {
+            int pick = k + prng() % (resources - k);
+            int t = pool[k]; pool[k] = pool[pick]; pool[pick] = t;
+            cg_add_resource(cg, i, pool[k]);
+        }
+    }
+    free(pool);
+    if(!cg_finalize(cg))
+    {
+        cg_free(cg);
+        return NULL;
+    }
+    return cg;
+}
+
+/*************************************************
+ * Function: cg_acquire
+ * Description: Waits for every resource a job needs, in ascending order
+ * Params: Conflict_graph pointer, job index
+ * Returns: None
+ * Pre-conditions: Graph is finalized and the job holds nothing
+ * Post-conditions: Job holds all of its resources
+ * **********************************************/
+void cg_acquire(Conflict_graph* cg, int job)
+{
+    Job* j = &cg->job[job];
+    int k; for(k = 0; k < j->count; k++)
+        sem_wait(&cg->locks[j->res[k]]);
+}
+
+/*************************************************
+ * Function: cg_release
+ * Description: Gives back every resource a job holds
+ * Params: Conflict_graph pointer, job index
+ * Returns: None
+ * Pre-conditions: Job holds all of its resources
+ * Post-conditions: Job holds nothing
+ * **********************************************/
+void cg_release(Conflict_graph* cg, int job)
+{
+    Job* j = &cg->job[job];
+    int k; for(k = j->count - 1; k >= 0; k--)
+        sem_post(&cg->locks[j->res[k]]);
+}
+
+/*************************************************
+ * Function: cg_edges
+ * Description: Counts the pairs of jobs that conflict (share at least one resource)
+ * Params: Conflict_graph pointer
+ * Returns: Number of edges in the conflict graph
+ * Pre-conditions: Graph is finalized
+ * Post-conditions: None
+ * **********************************************/
+long cg_edges(Conflict_graph* cg)
+{
+    long edges = 0;
+    int a, b, i, k;
+    for(a = 0; a < cg->jobs; a++)
+    {
+        for(b = a + 1; b < cg->jobs; b++)
+        {
+            Job* ja = &cg->job[a];
+            Job* jb = &cg->job[b];
+            for(i = 0, k = 0; i < ja->count && k < jb->count; ) //Both sets are sorted
+            {
+                if(ja->res[i] == jb->res[k])
+                {
+                    edges++;
+                    break;
+                }
+                if(ja->res[i] < jb->res[k])
+                    i++;
+                else
+                    k++;
+            }
+        }
+    }
+    return edges;
+}
@@ -0,0 +1,197 @@
+#pragma once
+
+//////////////////////////////////////////////////////
+// Packed fork bitmask for the dining philosophers.
+//
+// Fork f lives in bit (f % 64) of word (f / 64). A set bit means the fork is in someone's hand.
+// Philosopher s needs forks s and s+1 (wrapping to 0 at the end of the table). When both
+// forks sit in the same word they are taken together with one compare and swap, so the
+// philosopher gets both forks or neither. This also covers the table wrap (forks seats-1 and 0)
+// whenever the whole table fits in one word.
+//
+// The only seats whose forks straddle two words are the last seat of each word (fork 63 of
+// word w and fork 0 of word w+1) and, past 64 seats, the last seat of the table. Those take
+// the lower word's bit first and then the higher one, handing the first fork straight back if
+// the second is taken, so nobody ever holds one fork while blocked.
+//
+// A philosopher that loses the race parks on a futex keyed to its own seat. Putting forks down
+// only costs a syscall when a neighbour is actually parked.
+//////////////////////////////////////////////////////
+
+#include <stdint.h>
+#include <stdlib.h>
+#include "futex.h"
+
+#define FORK_WORD_BITS 64
+
+typedef struct ForkMask {
+    int seats;
+    int words;
+    uint64_t* bits; //One bit per fork, 1 = taken
+    int* wake; //Per seat futex word, bumped whenever a neighbour puts forks down
+    int* parked; //Per seat flag, set while the seat may be sleeping on its futex
+}ForkMask;
+
+/*************************************************
+ * Function: fm_init
+ * Description: Allocates a fork bitmask for the given number of seats with every fork on the table
+ * Params: Number of seats (at least 2)
+ * Returns: Pointer to the new ForkMask
+ * Pre-conditions: None
+ * Post-conditions: All forks are free and no seat is parked
+ * **********************************************/
+ForkMask* fm_init(int seats)
+{
+    ForkMask* fm = (ForkMask*)malloc(sizeof(ForkMask));
+    fm->seats = seats;
+    fm->words = (seats + FORK_WORD_BITS - 1) / FORK_WORD_BITS;
+    fm->bits = (uint64_t*)calloc(fm->words, sizeof(uint64_t));
+    fm->wake = (int*)calloc(seats, sizeof(int));
+    fm->parked = (int*)calloc(seats, sizeof(int));
+    return fm;
+}
+
+/*************************************************
+ * Function: fm_free
+ * Description: Frees a fork bitmask made by fm_init
+ * Params: ForkMask pointer
+ * Returns: None
+ * Pre-conditions: No seat is using it any more
+ * Post-conditions: Pointer is invalid
+ * **********************************************/
+void fm_free(ForkMask* fm)
+{
+    free(fm->bits);
+    free(fm->wake);
+    free(fm->parked);
+    free(fm);
+}
+
+/*************************************************
+ * Function: fm_take_bits
+ * Description: Sets every bit of mask in a word with a single compare and swap, only if none of them are already set
+ * Params: Address of the word, bits to take
+ * Returns: 1 if the bits were taken, 0 if any of them were already taken
+ * Pre-conditions: None
+ * Post-conditions: On success the caller owns every fork in mask
+ * **********************************************/
+int fm_take_bits(uint64_t* word, uint64_t mask)
+{
+    uint64_t old = __atomic_load_n(word, __ATOMIC_RELAXED);
+    do {
+        if(old & mask)
+            return 0;
+    } while(!__atomic_compare_exchange_n(word, &old, old | mask, 1, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED));
+    return 1;
+}
+
+/*************************************************
+ * Function: fm_notify
+ * Description: Wakes a seat if it is parked waiting for forks
+ * Params: ForkMask pointer, seat index
+ * Returns: None
+ * Pre-conditions: None
+ * Post-conditions: A parked seat will recheck its forks
+ * **********************************************/
+void fm_notify(ForkMask* fm, int seat)
+{
+    if(__atomic_load_n(&fm->parked[seat], __ATOMIC_RELAXED))
+    {
+        __atomic_fetch_add(&fm->wake[seat], 1, __ATOMIC_RELEASE);
+        futex_wake(&fm->wake[seat], 1);
+    }
+}
+
+/*************************************************
+ * Function: fm_try
+ * Description: Tries to pick up both forks for a seat. Never blocks and never leaves the seat holding a single fork.
+ * Params: ForkMask pointer, seat index
+ * Returns: 1 if the seat now holds both forks, 0 if it holds neither
+ * Pre-conditions: ForkMask has been initialized
+ * Post-conditions: None
+ * **********************************************/
+int fm_try(ForkMask* fm, int seat)
+{
+    int a = seat;
+    int b = (seat + 1) % fm->seats;
+    int wa = a / FORK_WORD_BITS;
+    int wb = b / FORK_WORD_BITS;
+    uint64_t ma = (uint64_t)1 << (a % FORK_WORD_BITS);
+    uint64_t mb = (uint64_t)1 << (b % FORK_WORD_BITS);
+
+    if(wa == wb) //Both forks in one word, including the table wrap when everything fits in one word
+        return fm_take_bits(&fm->bits[wa], ma | mb);
+
+    //Forks straddle a word boundary. Take the lower word first so every seat agrees on the order.
+    if(wb < wa)
+    {
+        int wt = wa; wa = wb; wb = wt;
+        uint64_t mt = ma; ma = mb; mb = mt;
+    }
+    if(!fm_take_bits(&fm->bits[wa], ma))
+        return 0;
+    if(!fm_take_bits(&fm->bits[wb], mb))
+    {
+        //Put the first fork back. A neighbour may have parked on it in the meantime.
+        __atomic_fetch_and(&fm->bits[wa], ~ma, __ATOMIC_RELEASE);
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        fm_notify(fm, (seat + fm->seats - 1) % fm->seats);
+        fm_notify(fm, (seat + 1) % fm->seats);
+        return 0;
+    }
+    return 1;
+}
+
+/*************************************************
+ * Function: fm_acquire
+ * Description: Picks up both forks for a seat, parking on the seat's futex until a neighbour puts a fork down if they are not available
+ * Params: ForkMask pointer, seat index
+ * Returns: None
+ * Pre-conditions: ForkMask has been initialized and the seat holds no forks
+ * Post-conditions: The seat holds both of its forks
+ * **********************************************/
+void fm_acquire(ForkMask* fm, int seat)
+{
+    while(!fm_try(fm, seat))
+    {
+        int seq = __atomic_load_n(&fm->wake[seat], __ATOMIC_ACQUIRE);
+        __atomic_store_n(&fm->parked[seat], 1, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_SEQ_CST); //Pairs with the fence in fm_release
+
+        //Check again after announcing ourselves, a neighbour may have put its forks down in between
+        if(fm_try(fm, seat))
+            break;
+        futex_wait(&fm->wake[seat], seq);
+    }
+    __atomic_store_n(&fm->parked[seat], 0, __ATOMIC_RELAXED);
+}
+
+/*************************************************
+ * Function: fm_release
+ * Description: Puts both forks for a seat back on the table and wakes the two neighbours that share them if they are parked
+ * Params: ForkMask pointer, seat index
+ * Returns: None
+ * Pre-conditions: The seat holds both of its forks
+ * Post-conditions: Both forks are free
+ * **********************************************/
+void fm_release(ForkMask* fm, int seat)
+{
+    int a = seat;
+    int b = (seat + 1) % fm->seats;
+    int wa = a / FORK_WORD_BITS;
+    int wb = b / FORK_WORD_BITS;
+    uint64_t ma = (uint64_t)1 << (a % FORK_WORD_BITS);
+    uint64_t mb = (uint64_t)1 << (b % FORK_WORD_BITS);
+
+    if(wa == wb)
+        __atomic_fetch_and(&fm->bits[wa], ~(ma | mb), __ATOMIC_RELEASE);
+    else
+    {
+        __atomic_fetch_and(&fm->bits[wa], ~ma, __ATOMIC_RELEASE);
+        __atomic_fetch_and(&fm->bits[wb], ~mb, __ATOMIC_RELEASE);
+    }
+    __atomic_thread_fence(__ATOMIC_SEQ_CST); //Either we see the neighbour parked or it sees the free forks
+
+    fm_notify(fm, (seat + fm->seats - 1) % fm->seats); //Left neighbour wants fork a
+    fm_notify(fm, b); //Right neighbour wants fork b
+}
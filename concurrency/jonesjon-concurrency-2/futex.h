@@ -0,0 +1,37 @@
+#pragma once
+
+//////////////////////////////////////////////////////
+// Thin wrappers around the linux futex system call.
+// Used to park threads on a single int in memory instead of on a semaphore.
+//////////////////////////////////////////////////////
+
+#include <unistd.h>
+#include <limits.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+/*************************************************
+ * Function: futex_wait
+ * Description: Puts the calling thread to sleep as long as *addr still holds val. Returns right away if it does not.
+ * Params: Address of the futex word, value the caller last saw in it
+ * Returns: None
+ * Pre-conditions: addr is 4 byte aligned and shared only between threads of this process
+ * Post-conditions: Caller has been woken, was interrupted or *addr had already changed. Callers must recheck their condition.
+ * **********************************************/
+void futex_wait(int* addr, int val)
+{
+    syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, val, NULL, NULL, 0);
+}
+
+/*************************************************
+ * Function: futex_wake
+ * Description: Wakes up to count threads sleeping on addr
+ * Params: Address of the futex word, max number of threads to wake (INT_MAX for all of them)
+ * Returns: None
+ * Pre-conditions: None
+ * Post-conditions: Up to count sleepers are runnable again
+ * **********************************************/
+void futex_wake(int* addr, int count)
+{
+    syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, count, NULL, NULL, 0);
+}
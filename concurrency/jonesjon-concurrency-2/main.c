@@ -8,40 +8,132 @@
 #include <stdlib.h>
 #include <pthread.h>
 #include <semaphore.h>
+#include <unistd.h>
+#include <string.h>
+#include <limits.h>
+#include <time.h>
+#include <sys/prctl.h>
+#include <sys/resource.h>
 #include "mt19937ar.h"
+#include "forkmask.h"
+#include "status.h"
+#include "metrics.h"
+#include "alloc.h"
+
+#define NUM_PHILOSOPHERS 5 //Default table size
+#define NUM_NAMES 16
+#define FRAME_RATE 10 //Default status redraws per second
+#define EXPORT_INTERVAL 5 //Default seconds between metrics exports
+#define BENCH_SECONDS 5 //Default length of a benchmark run
+#define BENCH_EAT_US 100 //Default benchmark eating time in microseconds
+#define BACKOFF_MIN_NS 1000 //First backoff after a failed attempt is up to 1us
+#define BACKOFF_MAX_NS 1000000 //Backoff stops doubling at 1ms
+
+//Philosopher names by seat, wrapped around for tables bigger than NUM_NAMES
+const char* names[NUM_NAMES] = {
+    "Aristotle", "Socrates", "Plato", "Pythagoras", "Democritus", "Epicurus", "Heraclitus", "Thales",
+    "Zeno", "Diogenes", "Parmenides", "Anaximander", "Empedocles", "Protagoras", "Hypatia", "Plotinus"
+};
 
-#define NUM_PHILOSOPHERS 5
+//How philosophers pick up their forks
+enum fork_modes {
+    MODE_FOOTMAN, //Footman semaphore plus one semaphore per fork
+    MODE_MASK, //Packed fork bitmask, both forks in one compare and swap
+    MODE_ORDERED, //Conflict graph engine, every resource taken in ascending order
+    MODE_BACKOFF //Take one fork, try the other, give it back and back off on failure
+};
 
-//Named philosophers for easy index access
-enum philosophers {
-    Aristotle,
-    Socrates,
-    Plato,
-    Pythagoras,
-    Democritus
+//Kinds of random conflict graphs for -G
+enum graph_kinds {
+    GRAPH_NONE,
+    GRAPH_SPARSE, //Every job needs 2 resources, about as connected as the ring
+    GRAPH_DENSE //Every job needs a quarter of all resources
 };
 
+//Labels for each fork_modes value, used on the command line and in exported metrics
+const char* mode_names[] = { "footman", "mask", "ordered", "backoff" };
+
+//Thinking time as a multiple of eating time for each benchmark run when -t is not given
+const double bench_ratios[] = { 10.0, 1.0, 0.1 };
+#define NUM_RATIOS (int)(sizeof(bench_ratios)/sizeof(bench_ratios[0]))
+#define NUM_MODES (int)(sizeof(mode_names)/sizeof(mode_names[0]))
+
+//Holds the command line settings for a run
+typedef struct Options {
+    int mode;
+    int mode_set; //1 if -m was given
+    int fps; //Status redraws per second
+    FILE* export; //Where metrics are exported to, NULL for no export
+    int interval; //Seconds between metrics exports
+    const char* graph_file; //Config file with job resource sets, NULL for none
+    int graph_kind; //Random graph to generate, GRAPH_NONE for none
+    int bench; //1 to benchmark instead of running forever
+    int duration; //Seconds per benchmark run
+    int think_us; //Benchmark thinking time, -1 to sweep bench_ratios
+    int eat_us; //Benchmark eating time
+}Options;
+
 //Holds the arguments to the thread function philosopher
 typedef struct Args {
     int name;
-    unsigned int* status;
-    sem_t* talk;
+    int mode;
+    Seat_status* status;
+    Seat_metrics* metrics;
     sem_t* footman;
-    sem_t* forks[NUM_PHILOSOPHERS];
+    sem_t** forks;
+    ForkMask* mask;
+    unsigned int seed; //Per thread random state for backoff delays (prng is not thread safe)
 }Args;
 
+//Holds the arguments to the thread function renderer
+typedef struct Render_args {
+    Seat_status* status;
+    int fps;
+}Render_args;
+
+//Holds the arguments to the thread function exporter
+typedef struct Export_args {
+    Seat_metrics* metrics;
+    FILE* out;
+    int interval;
+    int mode;
+    unsigned long long started;
+}Export_args;
+
+//Holds the arguments to the thread function bench_worker
+typedef struct Bench_args {
+    Args args;
+    int think_us;
+    int eat_us;
+    int* stop; //Set to 1 when the run is over
+}Bench_args;
+
 //Function prototypes
-void driver();
+void driver(Options*);
+Args setup_table(Options*);
+void teardown_table(Args*);
+void bench(Options*);
+void run_bench(Options*, int, int);
+void* bench_worker(void*);
 void* philosopher(void*);
-void show_status(unsigned int*);
+void* renderer(void*);
+void* exporter(void*);
+void show_status(unsigned int*, unsigned int*);
 void show_name(int);
+void show_forks(int, const char*);
+void acquire_forks(Args*);
+void release_forks(Args*);
 void get_forks(int, sem_t*, sem_t**);
 void put_forks(int, sem_t*, sem_t**);
+void get_forks_backoff(int, sem_t**, Seat_metrics*, unsigned int*);
+void put_forks_backoff(int, sem_t**);
 int right(int);
 unsigned int prng();
 
 //Global variables
 int bit;
+int seats = NUM_PHILOSOPHERS; //Number of philosophers (and forks) at the table
+Conflict_graph* graph = NULL; //Resource sets for MODE_ORDERED, NULL otherwise
 
 /* SOLUTION: From the little book of semaphores page 93
  *
@@ -55,8 +147,77 @@ int bit;
  *    footman.signal ()
  */
 
-int main()
+int main(int argc, char** argv)
 {
+    //The renderer builds each frame in the buffer and writes it out in one go. setvbuf is only allowed before anything
+    //else touches stdout, so it is set here; every other writer flushes or exits after printing.
+    setvbuf(stdout, NULL, _IOFBF, 1 << 16);
+
+    Options options;
+    options.mode = MODE_FOOTMAN;
+    options.mode_set = 0;
+    options.fps = FRAME_RATE;
+    options.export = NULL;
+    options.interval = EXPORT_INTERVAL;
+    options.graph_file = NULL;
+    options.graph_kind = GRAPH_NONE;
+    options.bench = 0;
+    options.duration = BENCH_SECONDS;
+    options.think_us = -1;
+    options.eat_us = BENCH_EAT_US;
+
+    int opt, m;
+    while((opt = getopt(argc, argv, "m:n:r:o:s:g:G:bd:t:e:")) != -1)
+    {
+        if(opt == 'm')
+        {
+            options.mode = -1;
+            for(m = 0; m < NUM_MODES; m++)
+            {
+                if(strcmp(optarg, mode_names[m]) == 0)
+                    options.mode = m;
+            }
+            if(options.mode == -1)
+                opt = '?';
+            options.mode_set = 1;
+        }
+        else if(opt == 'n' && atoi(optarg) >= 2)
+            seats = atoi(optarg);
+        else if(opt == 'r' && atoi(optarg) >= 1)
+            options.fps = atoi(optarg);
+        else if(opt == 'o')
+        {
+            options.export = fopen(optarg, "a"); //Append so several runs can share one file
+            if(options.export == NULL)
+                opt = '?';
+        }
+        else if(opt == 's' && atoi(optarg) >= 1)
+            options.interval = atoi(optarg);
+        else if(opt == 'g')
+            options.graph_file = optarg;
+        else if(opt == 'G' && strcmp(optarg, "sparse") == 0)
+            options.graph_kind = GRAPH_SPARSE;
+        else if(opt == 'G' && strcmp(optarg, "dense") == 0)
+            options.graph_kind = GRAPH_DENSE;
+        else if(opt == 'b')
+            options.bench = 1;
+        else if(opt == 'd' && atoi(optarg) >= 1)
+            options.duration = atoi(optarg);
+        else if(opt == 't' && atoi(optarg) >= 0)
+            options.think_us = atoi(optarg);
+        else if(opt == 'e' && atoi(optarg) >= 0)
+            options.eat_us = atoi(optarg);
+        else
+            opt = '?';
+
+        if(opt == '?')
+        {
+            printf("USAGE: main [-m footman|mask|ordered|backoff] [-n NUM_PHILOSOPHERS] [-r FRAMES_PER_SECOND] [-o METRICS_FILE] [-s EXPORT_SECONDS]\n");
+            printf("            [-g GRAPH_FILE | -G sparse|dense] [-b [-d SECONDS] [-t THINK_US] [-e EAT_US]]\n");
+            exit(1);
+        }
+    }
+
 	unsigned int eax;
     unsigned int ebx;
     unsigned int ecx;
@@ -83,67 +244,280 @@ int main()
         bit = 0; //Use mt19937 for the ENGR server and other processor chips
     }
 
+    //Build the conflict graph now that prng is seeded. Graphs always use ordered acquisition.
+    int want_graph = 1;
+    if(options.graph_file != NULL)
+        graph = cg_load(options.graph_file);
+    else if(options.graph_kind == GRAPH_SPARSE)
+        graph = cg_random(seats, seats, 2);
+    else if(options.graph_kind == GRAPH_DENSE)
+        graph = cg_random(seats, seats, seats / 4 > 2 ? seats / 4 : 2);
+    else if(options.mode == MODE_ORDERED || (options.bench && !options.mode_set))
+        graph = cg_ring(seats); //The benchmark sweep compares every mode, ordered included
+    else
+        want_graph = 0;
+    if(want_graph && graph == NULL)
+        exit(1);
+
+    if(options.graph_file != NULL || options.graph_kind != GRAPH_NONE)
+    {
+        seats = graph->jobs;
+        options.mode = MODE_ORDERED;
+    }
+
     //Run main program code
-    driver();
+    if(options.bench)
+        bench(&options);
+    else
+        driver(&options);
 
     return 0;
 }
 
 /*************************************************
- * Function: driver
- * Description: Runs the solution for the dining philosophers problem. Sets up semaphores and threads for execution.
- * Params: None
- * Returns: None
- * Pre-conditions: Bit is set for random number generation.
+ * Function: setup_table
+ * Description: Sets up semaphores, the fork bitmask, the status board and the metrics shared by every philosopher
+ * Params: Options struct from the command line
+ * Returns: Argument struct filled in for every field but name
+ * Pre-conditions: seats is final and graph is built if the mode needs one
  * Post-conditions: None
  * **********************************************/
-void driver()
+Args setup_table(Options* options)
 {
     //Initialize the values in the argument struct by allocating dynamic memory for pointers
     Args pt_args;
-    pt_args.status = (unsigned int*)malloc(sizeof(unsigned int)*5);
-    pt_args.talk = (sem_t*)malloc(sizeof(sem_t));
+    pt_args.mode = options->mode;
+    pt_args.status = ss_init(seats); //Every philosopher starts out thinking
+    pt_args.metrics = sm_init(seats);
     pt_args.footman = (sem_t*)malloc(sizeof(sem_t));
+    pt_args.forks = (sem_t**)malloc(sizeof(sem_t*)*seats);
+    pt_args.mask = fm_init(seats); //Only touched in MODE_MASK
 
-    sem_init(pt_args.talk, 0, 1); //Semaphore for stdout control
-    sem_init(pt_args.footman, 0, NUM_PHILOSOPHERS - 1); //Semaphore for number of o at table
+    sem_init(pt_args.footman, 0, seats - 1); //Semaphore for number of o at table
 
-    //Allocate and initialize the status array of ints and forks array of semaphores
-    int i; for(i = 0; i < NUM_PHILOSOPHERS; i++)
+    //Allocate and initialize the forks array of semaphores
+    int i; for(i = 0; i < seats; i++)
     {
-        pt_args.status[i] = 0;
         pt_args.forks[i] = (sem_t*)malloc(sizeof(sem_t));
         sem_init(pt_args.forks[i], 0, 1); //Semaphore for a single fork on the table
     }
+    return pt_args;
+}
 
-    //Initialize pthread variables and generate arguments structs for each philosopher
-    pthread_t aristotle, socrates, plato, pythagoras, democritus;
-    Args aristotle_args = pt_args, socrates_args = pt_args, plato_args = pt_args, pythagoras_args = pt_args, democritus_args = pt_args;
+/*************************************************
+ * Function: teardown_table
+ * Description: Destroys the semaphores and frees everything setup_table allocated
+ * Params: Argument struct returned by setup_table
+ * Returns: None
+ * Pre-conditions: Every philosopher using the table has been joined
+ * Post-conditions: Pointers in the struct are invalid
+ * **********************************************/
+void teardown_table(Args* pt_args)
+{
+    sem_destroy(pt_args->footman);
+    free(pt_args->footman);
+    int i; for(i = 0; i < seats; i++)
+    {
+        sem_destroy(pt_args->forks[i]);
+        free(pt_args->forks[i]);
+    }
+    free(pt_args->forks);
+    fm_free(pt_args->mask);
+    free(pt_args->status);
+    free(pt_args->metrics);
+}
 
-    //Create the philosopher threads with their respective arguments and names
-    aristotle_args.name = Aristotle;
-    pthread_create(&aristotle, NULL, philosopher, &aristotle_args);
+/*************************************************
+ * Function: driver
+ * Description: Runs the solution for the dining philosophers problem. Sets up the table and threads for execution.
+ * Params: Options struct from the command line
+ * Returns: None
+ * Pre-conditions: Bit is set for random number generation.
+ * Post-conditions: None
+ * **********************************************/
+void driver(Options* options)
+{
+    Args pt_args = setup_table(options);
+    int i;
+
+    //Start the renderer, the only thread that ever writes to stdout
+    pthread_t render_thread;
+    Render_args r_args;
+    r_args.status = pt_args.status;
+    r_args.fps = options->fps;
+    pthread_create(&render_thread, NULL, renderer, &r_args);
+
+    //Start the metrics exporter if there is somewhere to export to
+    pthread_t export_thread;
+    Export_args e_args;
+    e_args.metrics = pt_args.metrics;
+    e_args.out = options->export;
+    e_args.interval = options->interval;
+    e_args.mode = options->mode;
+    e_args.started = now_ns();
+    if(e_args.out != NULL)
+        pthread_create(&export_thread, NULL, exporter, &e_args);
+
+    //Generate an arguments struct for each philosopher and create the threads with their respective seats
+    pthread_t* threads = (pthread_t*)malloc(sizeof(pthread_t)*seats);
+    Args* args = (Args*)malloc(sizeof(Args)*seats);
+    for(i = 0; i < seats; i++)
+    {
+        args[i] = pt_args;
+        args[i].name = i;
+        args[i].seed = prng();
+        pthread_create(&threads[i], NULL, philosopher, &args[i]);
+    }
+
+    //Block the parent thread until completion of the first philosopher thread (Which never happens)
+    pthread_join(threads[0], NULL);
+}
+
+/*************************************************
+ * Function: bench
+ * Description: Benchmarks fork acquisition. On the ring it runs every mode (or just the -m one) at every think/eat ratio in
+ * bench_ratios (or just -t), on a conflict graph it runs ordered acquisition once. Prints one row per run.
+ * Params: Options struct from the command line
+ * Returns: None
+ * Pre-conditions: Bit is set for random number generation and the graph is built if any run needs one
+ * Post-conditions: Report has been printed to stdout
+ * **********************************************/
+void bench(Options* options)
+{
+    int m, r;
+    int only = (options->mode_set || options->graph_file != NULL || options->graph_kind != GRAPH_NONE) ? options->mode : -1; //Mode to restrict the runs to, -1 for all of them
+
+    prctl(PR_SET_TIMERSLACK, 1); //Microsecond sleeps should not be rounded up by the default 50us slack
+
+    if(graph != NULL)
+        printf("jobs=%d resources=%d conflicts=%ld\n", graph->jobs, graph->resources, cg_edges(graph));
+    printf("%-8s %6s %9s %9s %12s %12s %11s %7s %11s %10s %9s %12s\n", "mode", "seats", "think_us", "eat_us", "meals/s",
+        "mean_wait_us", "max_wait_us", "eaters", "jain_meals", "failed/s", "cpu_s", "cpu_us/meal");
+
+    for(m = 0; m < NUM_MODES; m++)
+    {
+        if(only != -1 && m != only)
+            continue;
+        if(options->think_us >= 0)
+            run_bench(options, m, options->think_us);
+        else
+        {
+            for(r = 0; r < NUM_RATIOS; r++)
+                run_bench(options, m, (int)(options->eat_us * bench_ratios[r]));
+        }
+    }
+}
+
+/*************************************************
+ * Function: run_bench
+ * Description: Runs a fresh table flat out for a fixed time with microsecond thinking and eating (no status screen) and prints
+ * throughput, wait times, concurrency, fairness, failed attempts and CPU use. Thinking and eating both sleep, so all CPU time is
+ * spent on fork acquisition.
+ * Params: Options struct from the command line, fork acquisition mode, thinking time in microseconds
+ * Returns: None
+ * Pre-conditions: graph is built if the mode is MODE_ORDERED
+ * Post-conditions: One report row has been printed to stdout
+ * **********************************************/
+void run_bench(Options* options, int mode, int think_us)
+{
+    int stop = 0;
+    int i;
+
+    options->mode = mode;
+    Args pt_args = setup_table(options);
+
+    struct rusage before, after;
+    getrusage(RUSAGE_SELF, &before);
+    unsigned long long started = now_ns();
+
+    pthread_t* threads = (pthread_t*)malloc(sizeof(pthread_t)*seats);
+    Bench_args* args = (Bench_args*)malloc(sizeof(Bench_args)*seats);
+    for(i = 0; i < seats; i++)
+    {
+        args[i].args = pt_args;
+        args[i].args.name = i;
+        args[i].args.seed = prng();
+        args[i].think_us = think_us;
+        args[i].eat_us = options->eat_us;
+        args[i].stop = &stop;
+        pthread_create(&threads[i], NULL, bench_worker, &args[i]);
+    }
+
+    sleep(options->duration);
+    __atomic_store_n(&stop, 1, __ATOMIC_RELAXED);
+    for(i = 0; i < seats; i++)
+        pthread_join(threads[i], NULL);
+
+    double elapsed = (now_ns() - started) / 1e9;
+    getrusage(RUSAGE_SELF, &after);
+    double cpu = (after.ru_utime.tv_sec - before.ru_utime.tv_sec) + (after.ru_utime.tv_usec - before.ru_utime.tv_usec) / 1e6
+               + (after.ru_stime.tv_sec - before.ru_stime.tv_sec) + (after.ru_stime.tv_usec - before.ru_stime.tv_usec) / 1e6;
+
+    double meals = 0, wait = 0, wait_max = 0, eating = 0, failed = 0;
+    double* per_seat = (double*)malloc(sizeof(double)*seats);
+    for(i = 0; i < seats; i++)
+    {
+        per_seat[i] = pt_args.metrics[i].meals;
+        meals += pt_args.metrics[i].meals;
+        failed += pt_args.metrics[i].failed;
+        wait += pt_args.metrics[i].wait_ns / 1e3;
+        eating += pt_args.metrics[i].eat_ns / 1e9;
+        if(pt_args.metrics[i].wait_max_ns / 1e3 > wait_max)
+            wait_max = pt_args.metrics[i].wait_max_ns / 1e3;
+    }
 
-    socrates_args.name = Socrates;
-    pthread_create(&socrates, NULL, philosopher, &socrates_args);
+    printf("%-8s %6d %9d %9d %12.0f %12.1f %11.0f %7.2f %11.4f %10.0f %9.3f %12.2f\n", mode_names[mode], seats, think_us, options->eat_us,
+        meals / elapsed, meals > 0 ? wait / meals : 0.0, wait_max, eating / elapsed, jain_index(per_seat, seats),
+        failed / elapsed, cpu, meals > 0 ? cpu * 1e6 / meals : 0.0);
+    fflush(stdout);
 
-    plato_args.name = Plato;
-    pthread_create(&plato, NULL, philosopher, &plato_args);
+    free(per_seat);
+    free(threads);
+    free(args);
+    teardown_table(&pt_args);
+}
 
-    pythagoras_args.name = Pythagoras;
-    pthread_create(&pythagoras, NULL, philosopher, &pythagoras_args);
+/*************************************************
+ * Function: bench_worker
+ * Description: The thread function for benchmark philosophers. Same loop as philosopher with microsecond sleeps, no status updates,
+ * and it stops once the run is over.
+ * Params: Bench_args struct pointer
+ * Returns: None
+ * Pre-conditions: Table has been set up
+ * Post-conditions: Philosopher holds no forks
+ * **********************************************/
+void* bench_worker(void* params)
+{
+    Bench_args* b_args = params;
+    Args* args = &b_args->args;
+    Seat_metrics* metrics = &args->metrics[args->name];
+    unsigned long long waited, ate;
+
+    struct timespec think, eat;
+    think.tv_sec = b_args->think_us / 1000000;
+    think.tv_nsec = (b_args->think_us % 1000000) * 1000L;
+    eat.tv_sec = b_args->eat_us / 1000000;
+    eat.tv_nsec = (b_args->eat_us % 1000000) * 1000L;
+
+    while(!__atomic_load_n(b_args->stop, __ATOMIC_RELAXED))
+    {
+        nanosleep(&think, NULL);
 
-    democritus_args.name = Democritus;
-    pthread_create(&democritus, NULL, philosopher, &democritus_args);
+        waited = sm_wait_begin(metrics);
+        acquire_forks(args);
+        ate = sm_wait_end(metrics, waited);
 
-    //Block the parent thread until completion of the aristotle thread (Which never happens)
-    pthread_join(aristotle, NULL);
+        nanosleep(&eat, NULL);
+        sm_meal(metrics, ate);
+        release_forks(args);
+    }
+    return NULL;
 }
 
 /*************************************************
  * Function: philosopher
  * Description: The thread function for all philosopher threads. Utilizes the solution from the little book of semaphores page 93.
- * Philosophers think, get forks, eat and then put down forks.
+ * Philosophers think, get forks, eat and then put down forks. State changes are published to the status board, never printed directly.
  * Params: Argument struct pointer
  * Returns: None
  * Pre-conditions: Argument struct pointer has values initialized with data
@@ -153,49 +527,113 @@ void* philosopher(void* params)
 {
     Args* args = params; //Create an argument struct pointer to fill with params
     int name = args->name; //Put the argument name into a buffer so we don't have to access it all the time (Its not a pointer and it doesn't need to change)
+    Seat_metrics* metrics = &args->metrics[name];
+    unsigned long long waited, ate;
     while(1)
     {
         //Think
-        sem_wait(args->talk); //Wait for availability of the talk semaphore for stdout and status array usage
-        args->status[name] = 0; //Update status to thinking for current philosopher index
-        show_status(args->status); //Print to stdout the status of every philosopher
-        sem_post(args->talk); //Yield control of the talk semaphore
-
         sleep((prng()%20)+1); //Sleep between 1 and 20 seconds for thinking
 
-        get_forks(name, args->footman, args->forks); //Get two adjacent forks for eating
+        waited = sm_wait_begin(metrics);
+        acquire_forks(args); //Get two adjacent forks for eating
+        ate = sm_wait_end(metrics, waited);
 
         //Eat
-        sem_wait(args->talk);
-        args->status[name] = 1;
-        show_status(args->status);
-        sem_post(args->talk);
-
+        ss_publish(&args->status[name], STATUS_EATING); //Update status to eating for current philosopher index
         sleep((prng()%8)+2); //Sleep between 2 and 9 seconds for eating
+        sm_meal(metrics, ate);
 
-        put_forks(name, args->footman, args->forks); //Yield usage of the two adjacent forks
+        //Back to thinking before the forks go down so the board never shows two neighbours eating at once
+        ss_publish(&args->status[name], STATUS_THINKING);
+        release_forks(args); //Yield usage of the two adjacent forks
+    }
+}
+
+/*************************************************
+ * Function: renderer
+ * Description: The thread function for the status renderer. Takes a snapshot of the status board a fixed number of times per second
+ * and redraws the screen whenever a philosopher's state changed. Philosophers never wait on it.
+ * Params: Render_args struct pointer
+ * Returns: None
+ * Pre-conditions: Status board has been initialized and fps is at least 1
+ * Post-conditions: None, never exits.
+ * **********************************************/
+void* renderer(void* params)
+{
+    Render_args* r_args = params;
+    unsigned int* state = (unsigned int*)malloc(sizeof(unsigned int)*seats);
+    unsigned int* meals = (unsigned int*)malloc(sizeof(unsigned int)*seats);
+    unsigned int* seen = (unsigned int*)malloc(sizeof(unsigned int)*seats); //Sequence number each seat was last drawn at
+
+    long frame_ns = 1000000000L / r_args->fps;
+    struct timespec frame;
+    frame.tv_sec = frame_ns / 1000000000L;
+    frame.tv_nsec = frame_ns % 1000000000L;
+
+    int i; for(i = 0; i < seats; i++)
+        seen[i] = UINT_MAX; //Forces the first frame to draw
+    while(1)
+    {
+        int changed = 0;
+        for(i = 0; i < seats; i++)
+        {
+            unsigned int seq = ss_read(&r_args->status[i], &state[i], &meals[i]);
+            if(seq != seen[i])
+                changed = 1;
+            seen[i] = seq;
+        }
+
+        if(changed)
+        {
+            show_status(state, meals);
+            fflush(stdout);
+        }
+        nanosleep(&frame, NULL);
+    }
+}
+
+/*************************************************
+ * Function: exporter
+ * Description: The thread function for the metrics exporter. Every interval seconds it appends one JSON line with the fairness
+ * and starvation counters of every philosopher to the export file.
+ * Params: Export_args struct pointer
+ * Returns: None
+ * Pre-conditions: Metrics have been initialized and the export file is open
+ * Post-conditions: None, never exits.
+ * **********************************************/
+void* exporter(void* params)
+{
+    Export_args* e_args = params;
+    while(1)
+    {
+        sleep(e_args->interval);
+        sm_export(e_args->out, mode_names[e_args->mode], e_args->metrics, seats, e_args->started);
     }
 }
 
 /*************************************************
  * Function: show_status
- * Description: Calls on the system to clear the screen then prints to stdout the status of all philosphers
- * Params: Unsigned int array of size NUM_PHILOSOPHERS that for each element is a 0 for thinking or a 1 for eating
+ * Description: Moves the cursor home and clears the screen with ANSI escape codes then prints to stdout the status of all philosphers
+ * Params: Unsigned int arrays of size seats. state holds STATUS_THINKING or STATUS_EATING and meals holds the meals eaten for each philosopher
  * Returns: None
- * Pre-conditions: Status array has allocated memory. 
+ * Pre-conditions: Arrays hold a snapshot of the status board. Only called from the renderer thread.
  * Post-conditions: Information has been printed to stdout
  * **********************************************/
-void show_status(unsigned int* status)
+void show_status(unsigned int* state, unsigned int* meals)
 {
-    system("clear");
+    printf("\033[H\033[2J");
     printf("-------------------------------------------------------------\n");
-    int i; for(i = 0; i < NUM_PHILOSOPHERS; i++)
+    int i; for(i = 0; i < seats; i++)
     {
         show_name(i);
-        if(status[i] == 0)
-            printf("is thinking.\n");
+        if(state[i] == STATUS_THINKING)
+            printf("is thinking. (%u meals)\n", meals[i]);
         else
-            printf("is eating with forks: %d and %d\n", i, right(i));
+        {
+            printf("is eating with forks: ");
+            show_forks(i, " and ");
+            printf(" (meal %u)\n", meals[i]);
+        }
     }
     printf("-------------------------------------------------------------\n");
 }
@@ -203,23 +641,76 @@ void show_status(unsigned int* status)
 /*************************************************
  * Function: show_name
  * Description: Gets the name (Index) of a philosopher in integer form and uses this to print to stdout the name of the philosopher.
- * Params: integer between 0 and NUM_PHILOSOPHERS
+ * Params: integer between 0 and seats
  * Returns: None
  * Pre-conditions: None 
  * Post-conditions: Philosopher name is printed to stdout
  * **********************************************/
 void show_name(int name)
 {
-    if(name == Aristotle)
-        printf("[0]\tF:(0,1) - Aristotle ");
-    else if(name == Socrates)
-        printf("[1]\tF:(1,2) - Socrates ");
-    else if(name == Plato)
-        printf("[2]\tF:(2,3) - Plato ");
-    else if(name == Pythagoras)
-        printf("[3]\tF:(3,4) - Pythagoras ");
+    printf("[%d]\tF:(", name);
+    show_forks(name, ",");
+    printf(") - %s ", names[name % NUM_NAMES]);
+}
+
+/*************************************************
+ * Function: show_forks
+ * Description: Prints the forks (resources) a philosopher needs. That is the two adjacent forks on the ring or the job's resource set on a conflict graph.
+ * Params: integer between 0 and seats, separator printed before the last fork
+ * Returns: None
+ * Pre-conditions: None
+ * Post-conditions: Fork list is printed to stdout
+ * **********************************************/
+void show_forks(int name, const char* last)
+{
+    if(graph == NULL)
+    {
+        printf("%d%s%d", name, last, right(name));
+        return;
+    }
+    Job* job = &graph->job[name];
+    int k; for(k = 0; k < job->count; k++)
+        printf("%s%d", k == 0 ? "" : (k == job->count - 1 ? last : ","), job->res[k]);
+}
+
+/*************************************************
+ * Function: acquire_forks
+ * Description: Gets both adjacent forks for a philosopher using whichever acquisition mode the table was started with
+ * Params: Argument struct pointer of the philosopher
+ * Returns: None
+ * Pre-conditions: Semaphores and fork bitmask have been allocated memory and initialized
+ * Post-conditions: Philosopher has exclusive access to the two adjacent forks
+ * **********************************************/
+void acquire_forks(Args* args)
+{
+    if(args->mode == MODE_MASK)
+        fm_acquire(args->mask, args->name);
+    else if(args->mode == MODE_ORDERED)
+        cg_acquire(graph, args->name);
+    else if(args->mode == MODE_BACKOFF)
+        get_forks_backoff(args->name, args->forks, &args->metrics[args->name], &args->seed);
+    else
+        get_forks(args->name, args->footman, args->forks);
+}
+
+/*************************************************
+ * Function: release_forks
+ * Description: Puts down both adjacent forks for a philosopher using whichever acquisition mode the table was started with
+ * Params: Argument struct pointer of the philosopher
+ * Returns: None
+ * Pre-conditions: Philosopher holds both adjacent forks
+ * Post-conditions: Exclusive access to the two adjacent forks has been yielded
+ * **********************************************/
+void release_forks(Args* args)
+{
+    if(args->mode == MODE_MASK)
+        fm_release(args->mask, args->name);
+    else if(args->mode == MODE_ORDERED)
+        cg_release(graph, args->name);
+    else if(args->mode == MODE_BACKOFF)
+        put_forks_backoff(args->name, args->forks);
     else
-        printf("[4]\tF:(4,0) - Democritus ");
+        put_forks(args->name, args->footman, args->forks);
 }
 
 /*************************************************
@@ -252,17 +743,62 @@ void put_forks(int seat, sem_t* footman, sem_t** forks)
     sem_post(footman);
 }
 
+/*************************************************
+ * Function: get_forks_backoff
+ * Description: Gets both adjacent forks without a footman. Waits for the philosopher's own fork, then only tries the right one.
+ * If the right fork is taken the first fork goes back on the table and the philosopher sleeps for a random time that doubles
+ * (up to a cap) after every failure, so neighbours stop retrying in lockstep. Nobody ever blocks while holding a fork, so there
+ * is no deadlock.
+ * Params: integer id of philosopher, array of forks semaphore pointers, metrics record of the philosopher, per thread random state
+ * Returns: None
+ * Pre-conditions: Semaphores have been allocated memory and initialized
+ * Post-conditions: Specified philosopher has exclusive access to the two adjacent forks
+ * **********************************************/
+void get_forks_backoff(int seat, sem_t** forks, Seat_metrics* metrics, unsigned int* seed)
+{
+    long limit = BACKOFF_MIN_NS;
+    while(1)
+    {
+        sem_wait(forks[seat]);
+        if(sem_trywait(forks[right(seat)]) == 0)
+            return;
+        sem_post(forks[seat]);
+        sm_failed(metrics);
+
+        struct timespec delay;
+        delay.tv_sec = 0;
+        delay.tv_nsec = rand_r(seed) % limit + 1;
+        nanosleep(&delay, NULL);
+        if(limit < BACKOFF_MAX_NS)
+            limit *= 2;
+    }
+}
+
+/*************************************************
+ * Function: put_forks_backoff
+ * Description: Yields both adjacent forks taken with get_forks_backoff
+ * Params: integer id of philosopher, array of forks semaphore pointers
+ * Returns: None
+ * Pre-conditions: Philosopher holds both adjacent forks
+ * Post-conditions: Exclusive access to the two adjacent forks has been yielded
+ * **********************************************/
+void put_forks_backoff(int seat, sem_t** forks)
+{
+    sem_post(forks[right(seat)]);
+    sem_post(forks[seat]);
+}
+
 /*************************************************
  * Function: right
  * Description: Gets the index position of the fork to the right of the philosopher and wraps the number since the table is circular
  * Params: Integer index of the philosopher position
- * Returns: integer index of adjacent fork to the right (i+1) % NUM_PHILOSOPHERS
+ * Returns: integer index of adjacent fork to the right (i+1) % seats
  * Pre-conditions: 
  * Post-conditions: 
  * **********************************************/
 int right(int i)
 {
-    return (i + 1) % NUM_PHILOSOPHERS;
+    return (i + 1) % seats;
 }
 
 /*************************************************
@@ -0,0 +1,203 @@
+#pragma once
+
+//////////////////////////////////////////////////////
+// Fairness and starvation counters for the dining philosophers.
+//
+// Each seat owns one cache line aligned record and is the only thread that writes it, so
+// recording is a handful of plain stores. The exporter reads the records with relaxed loads;
+// fields of one seat may be a meal apart from each other, which is fine for periodic stats.
+//
+// The average number of philosophers eating at once is the total time spent eating by all
+// seats divided by the wall clock time, so no shared counter is needed for it either.
+//////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+typedef struct Seat_metrics {
+    unsigned long long meals;
+    unsigned long long wait_ns; //Total time spent waiting for forks
+    unsigned long long wait_max_ns; //Longest single wait for forks
+    unsigned long long eat_ns; //Total time spent holding forks
+    unsigned long long waiting_since; //Start of the wait in progress, 0 while not waiting
+    unsigned long long failed; //Attempts that found a fork taken and had to back off
+}__attribute__((aligned(64))) Seat_metrics;
+
+/*************************************************
+ * Function: now_ns
+ * Description: Reads the monotonic clock
+ * Params: None
+ * Returns: Nanoseconds since an arbitrary fixed point
+ * Pre-conditions: None
+ * Post-conditions: None
+ * **********************************************/
+unsigned long long now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*************************************************
+ * Function: sm_init
+ * Description: Allocates zeroed metrics records for every seat
+ * Params: Number of seats
+ * Returns: Array of seats Seat_metrics records
+ * Pre-conditions: None
+ * Post-conditions: All counters are zero
+ * **********************************************/
+Seat_metrics* sm_init(int seats)
+{
+    Seat_metrics* metrics = (Seat_metrics*)aligned_alloc(64, sizeof(Seat_metrics)*seats);
+    int i; for(i = 0; i < seats; i++)
+    {
+        metrics[i].meals = 0;
+        metrics[i].wait_ns = 0;
+        metrics[i].wait_max_ns = 0;
+        metrics[i].eat_ns = 0;
+        metrics[i].waiting_since = 0;
+        metrics[i].failed = 0;
+    }
+    return metrics;
+}
+
+/*************************************************
+ * Function: sm_wait_begin
+ * Description: Marks the start of a wait for forks so a philosopher that is starving right now shows up before it finally eats
+ * Params: Metrics record of the seat
+ * Returns: Time the wait started
+ * Pre-conditions: Only the owning philosopher calls this
+ * Post-conditions: waiting_since is set
+ * **********************************************/
+unsigned long long sm_wait_begin(Seat_metrics* m)
+{
+    unsigned long long start = now_ns();
+    __atomic_store_n(&m->waiting_since, start, __ATOMIC_RELAXED);
+    return start;
+}
+
+/*************************************************
+ * Function: sm_wait_end
+ * Description: Records a finished wait for forks
+ * Params: Metrics record of the seat, time the wait started
+ * Returns: Time the wait ended (when the philosopher started eating)
+ * Pre-conditions: Only the owning philosopher calls this
+ * Post-conditions: Wait totals are updated and waiting_since is cleared
+ * **********************************************/
+unsigned long long sm_wait_end(Seat_metrics* m, unsigned long long start)
+{
+    unsigned long long end = now_ns();
+    unsigned long long waited = end - start;
+    __atomic_store_n(&m->wait_ns, m->wait_ns + waited, __ATOMIC_RELAXED);
+    if(waited > m->wait_max_ns)
+        __atomic_store_n(&m->wait_max_ns, waited, __ATOMIC_RELAXED);
+    __atomic_store_n(&m->waiting_since, 0, __ATOMIC_RELAXED);
+    return end;
+}
+
+/*************************************************
+ * Function: sm_meal
+ * Description: Records a finished meal
+ * Params: Metrics record of the seat, time the meal started
+ * Returns: None
+ * Pre-conditions: Only the owning philosopher calls this, while still holding its forks
+ * Post-conditions: Meal count and eating time are updated
+ * **********************************************/
+void sm_meal(Seat_metrics* m, unsigned long long start)
+{
+    __atomic_store_n(&m->eat_ns, m->eat_ns + (now_ns() - start), __ATOMIC_RELAXED);
+    __atomic_store_n(&m->meals, m->meals + 1, __ATOMIC_RELAXED);
+}
+
+/*************************************************
+ * Function: sm_failed
+ * Description: Records an acquisition attempt that had to give its first fork back
+ * Params: Metrics record of the seat
+ * Returns: None
+ * Pre-conditions: Only the owning philosopher calls this
+ * Post-conditions: Failed attempt count is updated
+ * **********************************************/
+void sm_failed(Seat_metrics* m)
+{
+    __atomic_store_n(&m->failed, m->failed + 1, __ATOMIC_RELAXED);
+}
+
+/*************************************************
+ * Function: jain_index
+ * Description: Jain's fairness index (sum x)^2 / (n * sum x^2). 1 means perfectly even, 1/n means one seat got everything.
+ * Params: Array of values, number of values
+ * Returns: Index between 1/n and 1, or 1 if every value is zero
+ * Pre-conditions: None
+ * Post-conditions: None
+ * **********************************************/
+double jain_index(const double* x, int n)
+{
+    double sum = 0, sum_sq = 0;
+    int i; for(i = 0; i < n; i++)
+    {
+        sum += x[i];
+        sum_sq += x[i] * x[i];
+    }
+    if(sum_sq == 0)
+        return 1.0;
+    return (sum * sum) / (n * sum_sq);
+}
+
+/*************************************************
+ * Function: sm_export
+ * Description: Writes one JSON object on one line with the counters of every seat, the average number of simultaneous eaters
+ * and Jain's fairness index over meals eaten and over time spent waiting
+ * Params: Output stream, label for the acquisition mode, metrics records, number of seats, time the table was set
+ * Returns: None
+ * Pre-conditions: out is open for writing
+ * Post-conditions: One line has been written and flushed
+ * **********************************************/
+void sm_export(FILE* out, const char* mode, Seat_metrics* metrics, int seats, unsigned long long started)
+{
+    unsigned long long now = now_ns();
+    double elapsed = (now - started) / 1e9;
+    double* meals = (double*)malloc(sizeof(double)*seats);
+    double* waits = (double*)malloc(sizeof(double)*seats);
+    double eating = 0;
+    int i;
+
+    fprintf(out, "{\"t\":%.3f,\"mode\":\"%s\",\"seats\":%d", elapsed, mode, seats);
+
+    fprintf(out, ",\"meals\":[");
+    for(i = 0; i < seats; i++)
+    {
+        meals[i] = __atomic_load_n(&metrics[i].meals, __ATOMIC_RELAXED);
+        fprintf(out, "%s%.0f", i ? "," : "", meals[i]);
+    }
+
+    fprintf(out, "],\"wait_total_ms\":[");
+    for(i = 0; i < seats; i++)
+    {
+        waits[i] = __atomic_load_n(&metrics[i].wait_ns, __ATOMIC_RELAXED) / 1e6;
+        fprintf(out, "%s%.3f", i ? "," : "", waits[i]);
+    }
+
+    fprintf(out, "],\"wait_max_ms\":[");
+    for(i = 0; i < seats; i++)
+        fprintf(out, "%s%.3f", i ? "," : "", __atomic_load_n(&metrics[i].wait_max_ns, __ATOMIC_RELAXED) / 1e6);
+
+    fprintf(out, "],\"failed\":[");
+    for(i = 0; i < seats; i++)
+        fprintf(out, "%s%llu", i ? "," : "", __atomic_load_n(&metrics[i].failed, __ATOMIC_RELAXED));
+
+    fprintf(out, "],\"wait_now_ms\":[");
+    for(i = 0; i < seats; i++)
+    {
+        unsigned long long since = __atomic_load_n(&metrics[i].waiting_since, __ATOMIC_RELAXED);
+        fprintf(out, "%s%.3f", i ? "," : "", (since && since < now) ? (now - since) / 1e6 : 0.0);
+        eating += __atomic_load_n(&metrics[i].eat_ns, __ATOMIC_RELAXED) / 1e9;
+    }
+
+    fprintf(out, "],\"avg_eaters\":%.4f,\"jain_meals\":%.4f,\"jain_wait\":%.4f}\n",
+        elapsed > 0 ? eating / elapsed : 0.0, jain_index(meals, seats), jain_index(waits, seats));
+    fflush(out);
+
+    free(meals);
+    free(waits);
+}
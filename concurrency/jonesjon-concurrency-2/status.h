@@ -0,0 +1,84 @@
+#pragma once
+
+//////////////////////////////////////////////////////
+// Lock free status board for the dining philosophers.
+//
+// Every seat has its own slot guarded by a sequence lock. Only the philosopher in that seat
+// ever writes the slot, so writers never wait on anything: they bump the sequence to an odd
+// value, store the fields and bump it back to even. Readers (the renderer thread) copy the
+// fields and retry if the sequence was odd or moved while they were copying.
+// Slots are cache line aligned so neighbours publishing at the same time do not share a line.
+//////////////////////////////////////////////////////
+
+#include <stdlib.h>
+
+#define STATUS_THINKING 0
+#define STATUS_EATING 1
+
+typedef struct Seat_status {
+    unsigned int seq; //Odd while the seat is writing
+    unsigned int state; //STATUS_THINKING or STATUS_EATING
+    unsigned int meals; //Number of times the seat has started eating
+}__attribute__((aligned(64))) Seat_status;
+
+/*************************************************
+ * Function: ss_init
+ * Description: Allocates a status board with every seat thinking and no meals eaten
+ * Params: Number of seats
+ * Returns: Array of seats Seat_status slots
+ * Pre-conditions: None
+ * Post-conditions: All slots are zeroed with even sequence numbers
+ * **********************************************/
+Seat_status* ss_init(int seats)
+{
+    Seat_status* board = (Seat_status*)aligned_alloc(64, sizeof(Seat_status)*seats);
+    int i; for(i = 0; i < seats; i++)
+    {
+        board[i].seq = 0;
+        board[i].state = STATUS_THINKING;
+        board[i].meals = 0;
+    }
+    return board;
+}
+
+/*************************************************
+ * Function: ss_publish
+ * Description: Publishes a new state for a seat. Never blocks.
+ * Params: Slot of the seat, new state
+ * Returns: None
+ * Pre-conditions: Only the philosopher that owns the slot calls this
+ * Post-conditions: Readers will see the new state (and meal count if the seat started eating)
+ * **********************************************/
+void ss_publish(Seat_status* slot, unsigned int state)
+{
+    unsigned int seq = __atomic_load_n(&slot->seq, __ATOMIC_RELAXED);
+    __atomic_store_n(&slot->seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE); //Odd sequence is visible before any field changes
+
+    __atomic_store_n(&slot->state, state, __ATOMIC_RELAXED);
+    if(state == STATUS_EATING)
+        __atomic_store_n(&slot->meals, slot->meals + 1, __ATOMIC_RELAXED);
+
+    __atomic_store_n(&slot->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+/*************************************************
+ * Function: ss_read
+ * Description: Takes a consistent copy of a seat's slot, retrying while the seat is in the middle of publishing
+ * Params: Slot of the seat, addresses to copy the state and meal count into
+ * Returns: Sequence number the copy was taken at (even)
+ * Pre-conditions: None
+ * Post-conditions: state and meals hold values that were published together
+ * **********************************************/
+unsigned int ss_read(Seat_status* slot, unsigned int* state, unsigned int* meals)
+{
+    unsigned int before, after;
+    do {
+        before = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+        *state = __atomic_load_n(&slot->state, __ATOMIC_RELAXED);
+        *meals = __atomic_load_n(&slot->meals, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE); //Field loads finish before the sequence is checked again
+        after = __atomic_load_n(&slot->seq, __ATOMIC_RELAXED);
+    } while((before & 1) || before != after);
+    return before;
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+//////////////////////////////////////////////////////
+// K-way batch admission gate.
+//
+// Up to K threads may use the resource at once. As long as fewer than K are inside, new threads
+// walk right in. Once the K-th thread enters the gate closes, and nobody else gets in until every
+// thread of that group has left. The last one out reopens the gate for the next phase.
+//
+// The whole state is one 32 bit word, so entering and leaving are a single compare and swap when
+// nobody is fighting over it:
+//     bits  0-14  occupancy (threads inside)
+//     bit   15    closed (a full group is inside, arrivals must wait)
+//     bit   16    waiters (somebody is parked on the word)
+//     bits 17-31  phase (bumped every time a full group drains, wraps around)
+// Arrivals that find the gate closed park on the word itself with a futex. The thread that drains
+// the group wakes all of them with one futex wake, and only if the waiters bit says anyone is there.
+//////////////////////////////////////////////////////
+
+#include <limits.h>
+#include "futex.h"
+
+#define GATE_OCCUPANCY 0x7fffu
+#define GATE_CLOSED (1u << 15)
+#define GATE_WAITERS (1u << 16)
+#define GATE_PHASE_SHIFT 17
+#define GATE_MAX_K GATE_OCCUPANCY
+
+typedef struct Gate {
+	unsigned int word;
+	unsigned int k;
+}Gate;
+
+/*************************************************
+ * Function: gate_init
+ * Description: Sets up an open, empty gate
+ * Params: Gate pointer, capacity K
+ * Returns: None
+ * Pre-conditions: K is between 1 and GATE_MAX_K
+ * Post-conditions: Gate is open in phase 0 with nobody inside
+ * **********************************************/
+void gate_init(Gate* gate, unsigned int k)
+{
+	gate->word = 0;
+	gate->k = k;
+}
+
+/*************************************************
+ * Function: gate_enter
+ * Description: Waits until the gate is open and takes a place in the current group. Closes the gate if this thread fills the group.
+ * Params: Gate pointer
+ * Returns: Number of threads inside (including this one) right after entering
+ * Pre-conditions: Gate has been initialized
+ * Post-conditions: Calling thread is inside the gate
+ * **********************************************/
+unsigned int gate_enter(Gate* gate)
+{
+	unsigned int old = __atomic_load_n(&gate->word, __ATOMIC_RELAXED);
+	while(1)
+	{
+		if(!(old & GATE_CLOSED))
+		{
+			unsigned int inside = (old & GATE_OCCUPANCY) + 1;
+			unsigned int next = old + 1;
+			if(inside == gate->k)
+				next |= GATE_CLOSED; //We filled the group, everyone else waits for it to drain
+			if(__atomic_compare_exchange_n(&gate->word, &old, next, 1, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+				return inside;
+			continue;
+		}
+
+		//Closed. Make sure the drainer knows to wake us, then sleep until the word changes.
+		if(!(old & GATE_WAITERS) && !__atomic_compare_exchange_n(&gate->word, &old, old | GATE_WAITERS, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+			continue;
+		futex_wait((int*)&gate->word, (int)(old | GATE_WAITERS));
+		old = __atomic_load_n(&gate->word, __ATOMIC_RELAXED);
+	}
+}
+
+/*************************************************
+ * Function: gate_exit
+ * Description: Leaves the gate. If this thread is the last of a full group it reopens the gate for the next phase and wakes every parked arrival at once.
+ * Params: Gate pointer
+ * Returns: None
+ * Pre-conditions: Calling thread is inside the gate
+ * Post-conditions: Calling thread is outside the gate
+ * **********************************************/
+void gate_exit(Gate* gate)
+{
+	unsigned int old = __atomic_load_n(&gate->word, __ATOMIC_RELAXED);
+	unsigned int next;
+	do {
+		if((old & GATE_CLOSED) && (old & GATE_OCCUPANCY) == 1)
+			next = ((old >> GATE_PHASE_SHIFT) + 1) << GATE_PHASE_SHIFT; //Last of the group out: open, empty, no waiters, next phase
+		else
+			next = old - 1;
+	} while(!__atomic_compare_exchange_n(&gate->word, &old, next, 1, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+
+	if((old & GATE_CLOSED) && (old & GATE_OCCUPANCY) == 1 && (old & GATE_WAITERS))
+		futex_wake((int*)&gate->word, INT_MAX);
+}
+
+/*************************************************
+ * Function: gate_phase
+ * Description: Reads which phase (group) the gate is on
+ * Params: Gate pointer
+ * Returns: Phase number, counting drained groups (wraps around)
+ * Pre-conditions: Gate has been initialized
+ * Post-conditions: None
+ * **********************************************/
+unsigned int gate_phase(Gate* gate)
+{
+	return __atomic_load_n(&gate->word, __ATOMIC_RELAXED) >> GATE_PHASE_SHIFT;
+}
@@ -9,7 +9,29 @@
 #include <unistd.h> //For processes
 #include <pthread.h> //For threads
 #include <semaphore.h>
+#include <string.h>
 #include "mt19937ar.h"
+#include <time.h>
+#include "gate.h"
+#include "ticket.h"
+#include "waits.h"
+
+#define CAPACITY 3 //Default number of threads that fill the resource
+#define NUM_THREADS 3 //Default number of threads competing for the resource
+#define HOLD_US 100 //Default benchmark time inside the resource in microseconds
+
+//How threads are let into the resource
+enum admission_modes {
+	MODE_SEM, //Lightswitch plus count and empty semaphores
+	MODE_GATE, //Single word batch admission gate
+	MODE_TICKET //Batch gate with tickets so threads get in in arrival order
+};
+
+//Labels for each admission_modes value, used on the command line and in reports
+const char* mode_names[] = { "sem", "gate", "ticket" };
+#define NUM_MODES (int)(sizeof(mode_names)/sizeof(mode_names[0]))
+
+int quiet = 0; //1 to silence the lightswitch while benchmarking
 
 //Constructed from equivalent python implementation in little book of semaphores page 70
 typedef struct Lightswitch { 
@@ -32,7 +54,8 @@ void ls_unlock(Lightswitch* ls, sem_t* s)
 	ls->counter -= 1;
 	if(ls->counter == 0)
     {
-        printf("Empty counter\n");
+        if(!quiet)
+            printf("Empty counter\n");
 		sem_post(s);
     }
 	sem_post(ls->mutex);
@@ -43,17 +66,70 @@ typedef struct Args_t {
 	sem_t* count;
     sem_t* empty;
     sem_t* talk;
+	Gate* gate;
+	Ticket_gate* tickets;
+	int mode;
 }Args_t;
 
-void driver();
+//Arguments for the benchmark threads
+typedef struct Bench_args {
+	Args_t* shared;
+	Wait_stats stats; //Admission waits of this thread
+	unsigned int seed; //Per thread random state (prng is not thread safe)
+	int hold_us;
+	int* stop; //Set to 1 when the run is over
+}Bench_args;
+
+void driver(int, int, int, int, int);
 unsigned int prng();
+unsigned int admit(Args_t*);
+void leave(Args_t*);
 void* thread_f(void*);
+void* bench_thread_f(void*);
+void report(const char*, const char*, Wait_stats*);
 pthread_t* get_threads(int num_threads, void* function, void* args);
 
 int bit;
 
-int main()
+int main(int argc, char** argv)
 {
+	int mode = MODE_SEM;
+	int capacity = CAPACITY;
+	int num_threads = NUM_THREADS;
+	int bench_seconds = 0;
+	int hold_us = HOLD_US;
+	int opt, m;
+	while((opt = getopt(argc, argv, "m:k:n:b:u:")) != -1)
+	{
+		if(opt == 'm')
+		{
+			mode = -1;
+			for(m = 0; m < NUM_MODES; m++)
+			{
+				if(strcmp(optarg, mode_names[m]) == 0)
+					mode = m;
+			}
+			if(mode == -1)
+				opt = '?';
+		}
+		else if(opt == 'k' && atoi(optarg) >= 1 && atoi(optarg) <= (int)GATE_MAX_K)
+			capacity = atoi(optarg);
+		else if(opt == 'n' && atoi(optarg) >= 1)
+			num_threads = atoi(optarg);
+		else if(opt == 'b' && atoi(optarg) >= 1)
+			bench_seconds = atoi(optarg);
+		else if(opt == 'u' && atoi(optarg) >= 0)
+			hold_us = atoi(optarg);
+		else
+			opt = '?';
+
+		if(opt == '?')
+		{
+			printf("USAGE: main [-m sem|gate|ticket] [-k CAPACITY] [-n NUM_THREADS] [-b SECONDS [-u HOLD_US]]\n");
+			exit(1);
+		}
+	}
+
 	unsigned int eax;
     unsigned int ebx;
     unsigned int ecx;
@@ -81,20 +157,22 @@ int main()
     }
 
     //Run main program code
-    driver();
+    driver(mode, capacity, num_threads, bench_seconds, hold_us);
 
     return 0;
 }
 
 /*************************************************
  * Function: Runs the main program code
- * Description: Sets up the semaphores and the threads for execution
- * Params: none
+ * Description: Sets up the semaphores, the gates and the threads for execution. In benchmark mode runs the threads for a fixed time
+ * and prints their admission wait percentiles.
+ * Params: admission mode, number of threads that fill the resource, number of threads competing for it,
+ *         benchmark length in seconds (0 to run forever), benchmark time inside the resource in microseconds
  * Returns: none
  * Pre-conditions: bit is set so prng knows what random number generator to use 
  * Post-conditions: none
  * **********************************************/
-void driver()
+void driver(int mode, int capacity, int num_threads, int bench_seconds, int hold_us)
 {
     //Initialize semaphores and the locks
     Lightswitch lock;
@@ -110,7 +188,7 @@ void driver()
     //Initialize semaphore values
     sem_init(lock.mutex, 0, 1);
     sem_init(empty, 0, 1);
-	sem_init(count, 0, 3);
+	sem_init(count, 0, capacity);
     sem_init(talk, 0, 1);
 
     //Fill the arguments to be passed into the threads
@@ -119,22 +197,100 @@ void driver()
     arguments.count = count;
     arguments.empty = empty;
     arguments.talk = talk;
+	arguments.gate = (Gate*)malloc(sizeof(Gate));
+	gate_init(arguments.gate, capacity);
+	arguments.tickets = (Ticket_gate*)malloc(sizeof(Ticket_gate));
+	tg_init(arguments.tickets, capacity);
+	arguments.mode = mode;
+
+	if(bench_seconds > 0)
+	{
+		//Run every thread flat out, then report how long each one waited to get in
+		quiet = 1;
+		int stop = 0;
+		pthread_t* bench_threads = (pthread_t*)malloc(sizeof(pthread_t)*num_threads);
+		Bench_args* b_args = (Bench_args*)calloc(num_threads, sizeof(Bench_args));
+		int i; for(i = 0; i < num_threads; i++)
+		{
+			b_args[i].shared = &arguments;
+			b_args[i].seed = prng();
+			b_args[i].hold_us = hold_us;
+			b_args[i].stop = &stop;
+			pthread_create(&bench_threads[i], NULL, bench_thread_f, &b_args[i]);
+		}
+		sleep(bench_seconds);
+		__atomic_store_n(&stop, 1, __ATOMIC_RELAXED);
+
+		Wait_stats all = { NULL, 0, 0 };
+		char id[16];
+		printf("%-7s %6s %9s %8s %8s %8s %8s %8s\n", "mode", "thread", "admits", "p50_us", "p90_us", "p99_us", "p999_us", "max_us");
+		for(i = 0; i < num_threads; i++)
+		{
+			pthread_join(bench_threads[i], NULL);
+			ws_merge(&all, &b_args[i].stats);
+			snprintf(id, sizeof(id), "%d", i);
+			report(mode_names[mode], id, &b_args[i].stats);
+		}
+		report(mode_names[mode], "all", &all);
+		return;
+	}
 
-    //Generate 5 threads
+    //Generate the competing threads
 	pthread_t *threads;
-	threads = get_threads(3, thread_f, &arguments);
+	threads = get_threads(num_threads, thread_f, &arguments);
 
     //Block the main thread forever
     pthread_join(threads[0], NULL);
 	return;
 }
 
+/*************************************************
+ * Function: admit
+ * Description: Waits for a place in the resource using whichever admission mode the program was started with
+ * Params: Args_t arguments structure
+ * Returns: Number of threads using the resource right after this one got in
+ * Pre-conditions: Semaphores and gates are set up
+ * Post-conditions: Calling thread is using the resource
+ * **********************************************/
+unsigned int admit(Args_t* arguments)
+{
+	if(arguments->mode == MODE_GATE)
+		return gate_enter(arguments->gate); //Waits while a full group is inside
+	if(arguments->mode == MODE_TICKET)
+		return tg_enter(arguments->tickets); //Also waits for every thread that arrived earlier
+
+	ls_lock(arguments->lock, arguments->empty); //Lock the lightswitch to help determine when resource usage is empty or full
+	sem_wait(arguments->count); //Semaphore that governs CAPACITY threads at once
+	return arguments->lock->counter;
+}
+
+/*************************************************
+ * Function: leave
+ * Description: Gives up a place in the resource using whichever admission mode the program was started with
+ * Params: Args_t arguments structure
+ * Returns: none
+ * Pre-conditions: Calling thread is using the resource
+ * Post-conditions: Calling thread is not using the resource
+ * **********************************************/
+void leave(Args_t* arguments)
+{
+	if(arguments->mode == MODE_GATE)
+		gate_exit(arguments->gate); //Last one out of a full group lets the next group in
+	else if(arguments->mode == MODE_TICKET)
+		tg_exit(arguments->tickets);
+	else
+	{
+		sem_post(arguments->count);
+		ls_unlock(arguments->lock, arguments->empty);
+	}
+}
+
 /*************************************************
  * Function: thread_f
- * Description: The thread function. Makes use of the semaphores to show a solution to the resource problem.
+ * Description: The thread function. Makes use of the semaphores or the gates to show a solution to the resource problem.
  * Params: Args_t arguments structure
  * Returns: none
- * Pre-conditions: Semaphores are set up and arguments have valid values 
+ * Pre-conditions: Semaphores and gates are set up and arguments have valid values
  * Post-conditions: none
  * **********************************************/
 void* thread_f(void* args)
@@ -142,12 +298,16 @@ void* thread_f(void* args)
 	Args_t* arguments = (Args_t*)args; //Get arguments from void*
 	while(1)
 	{
-		ls_lock(arguments->lock, arguments->empty); //Lock the lightswitch to help determine when resource usage is empty or full
-        sem_wait(arguments->count); //Semaphore that governs 3 threads at once
+		unsigned int inside = admit(arguments);
 
         //Semaphore to govern the usage of STDOUT
         sem_wait(arguments->talk);
-		printf("%d: A thread is using the resource\n", arguments->lock->counter);
+		if(arguments->mode == MODE_GATE)
+			printf("%u: A thread is using the resource (group %u)\n", inside, gate_phase(arguments->gate));
+		else if(arguments->mode == MODE_TICKET)
+			printf("%u: A thread is using the resource (group %u)\n", inside, gate_phase(&arguments->tickets->gate));
+		else
+			printf("%u: A thread is using the resource\n", inside);
         sem_post(arguments->talk);
 
         sleep(2); //Wait a few seconds for the resource usage
@@ -156,12 +316,58 @@ void* thread_f(void* args)
         printf(": A thread is finished using the resource\n");
         sem_post(arguments->talk);
 
-        sem_post(arguments->count);
-		ls_unlock(arguments->lock, arguments->empty);
+		leave(arguments);
         sleep(prng()%10+1); //Wait between 1 and 10 seconds before this thread tries to use the resource again
 	}
 }
 
+/*************************************************
+ * Function: bench_thread_f
+ * Description: The thread function for benchmark mode. Uses the resource for hold_us microseconds, stays away for a random 0 to 2*hold_us
+ * microseconds and records how long every admission took, until the run is over.
+ * Params: Bench_args structure
+ * Returns: none
+ * Pre-conditions: Semaphores and gates are set up and arguments have valid values
+ * Post-conditions: Thread is not using the resource
+ * **********************************************/
+void* bench_thread_f(void* args)
+{
+	Bench_args* b_args = (Bench_args*)args;
+	struct timespec hold, away;
+	hold.tv_sec = b_args->hold_us / 1000000;
+	hold.tv_nsec = (b_args->hold_us % 1000000) * 1000L;
+	away.tv_sec = 0;
+
+	while(!__atomic_load_n(b_args->stop, __ATOMIC_RELAXED))
+	{
+		away.tv_nsec = (rand_r(&b_args->seed) % (2 * b_args->hold_us + 1)) % 1000000 * 1000L;
+		nanosleep(&away, NULL);
+
+		unsigned long long arrived = now_us();
+		admit(b_args->shared);
+		ws_add(&b_args->stats, now_us() - arrived);
+
+		nanosleep(&hold, NULL);
+		leave(b_args->shared);
+	}
+	return NULL;
+}
+
+/*************************************************
+ * Function: report
+ * Description: Prints one row of admission wait percentiles
+ * Params: mode label, thread label, Wait_stats of the thread (or all threads)
+ * Returns: none
+ * Pre-conditions: Nobody is still adding samples
+ * Post-conditions: Samples are sorted and the row is printed to stdout
+ * **********************************************/
+void report(const char* mode, const char* thread, Wait_stats* stats)
+{
+	ws_sort(stats);
+	printf("%-7s %6s %9d %8u %8u %8u %8u %8u\n", mode, thread, stats->count, ws_percentile(stats, 50), ws_percentile(stats, 90),
+		ws_percentile(stats, 99), ws_percentile(stats, 99.9), ws_percentile(stats, 100));
+}
+
 /*************************************************
  * Function: get_threads
  * Description: Creates and returns a certain number of threads given the function and arguments to use
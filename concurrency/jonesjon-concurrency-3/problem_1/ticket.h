@@ -0,0 +1,100 @@
+#pragma once
+
+//////////////////////////////////////////////////////
+// FIFO ticketed admission in front of the K-way batch gate.
+//
+// Every arrival draws a ticket. Only the holder of the oldest ticket is allowed to try the gate,
+// so threads get in strictly in arrival order: when a group drains, the next K tickets walk in one
+// after another and become the next group. Nobody can be skipped over.
+//
+// Waiting for a turn uses an array of slots (Anderson's queue lock). Ticket t waits on slot
+// t % TICKET_SLOTS until it holds t, so each waiter spins on its own cache line, and passing the
+// turn on wakes only the slot of the next ticket. Waiters spin a little before parking on the slot
+// with a futex, and the passer only makes the wake syscall if someone is parked there.
+//////////////////////////////////////////////////////
+
+#include <limits.h>
+#include "futex.h"
+#include "gate.h"
+
+#define TICKET_SLOTS 64 //Power of two. More threads than slots still works, they just share slots.
+#define TICKET_SPIN 200 //Checks of the slot before parking
+
+typedef struct Ticket_slot {
+	unsigned int turn; //Ticket allowed to go next among those mapped to this slot
+	int parked; //Threads sleeping on turn
+}__attribute__((aligned(64))) Ticket_slot;
+
+typedef struct Ticket_gate {
+	Gate gate;
+	unsigned int next; //Next ticket to hand out
+	Ticket_slot slot[TICKET_SLOTS];
+}Ticket_gate;
+
+/*************************************************
+ * Function: tg_init
+ * Description: Sets up an empty ticket gate where ticket 0 goes first
+ * Params: Ticket_gate pointer, capacity K
+ * Returns: None
+ * Pre-conditions: K is between 1 and GATE_MAX_K
+ * Post-conditions: Gate is open and no tickets are out
+ * **********************************************/
+void tg_init(Ticket_gate* tg, unsigned int k)
+{
+	gate_init(&tg->gate, k);
+	tg->next = 0;
+	int i; for(i = 0; i < TICKET_SLOTS; i++)
+	{
+		tg->slot[i].turn = (unsigned int)i - TICKET_SLOTS; //A ticket that is only reached after the counter wraps
+		tg->slot[i].parked = 0;
+	}
+	tg->slot[0].turn = 0;
+}
+
+/*************************************************
+ * Function: tg_enter
+ * Description: Draws a ticket, waits for every earlier ticket to get in, then enters the gate (waiting for the current group to drain if it is full)
+ * and hands the turn to the next ticket
+ * Params: Ticket_gate pointer
+ * Returns: Number of threads inside (including this one) right after entering
+ * Pre-conditions: Ticket gate has been initialized
+ * Post-conditions: Calling thread is inside the gate
+ * **********************************************/
+unsigned int tg_enter(Ticket_gate* tg)
+{
+	unsigned int ticket = __atomic_fetch_add(&tg->next, 1, __ATOMIC_RELAXED);
+	Ticket_slot* mine = &tg->slot[ticket & (TICKET_SLOTS - 1)];
+
+	int spins = 0;
+	while(__atomic_load_n(&mine->turn, __ATOMIC_ACQUIRE) != ticket)
+	{
+		if(++spins < TICKET_SPIN)
+			continue;
+		__atomic_fetch_add(&mine->parked, 1, __ATOMIC_SEQ_CST);
+		unsigned int seen = __atomic_load_n(&mine->turn, __ATOMIC_SEQ_CST);
+		if(seen != ticket)
+			futex_wait((int*)&mine->turn, (int)seen);
+		__atomic_fetch_sub(&mine->parked, 1, __ATOMIC_RELAXED);
+	}
+
+	unsigned int inside = gate_enter(&tg->gate); //Only the head of the line ever waits here
+
+	Ticket_slot* next = &tg->slot[(ticket + 1) & (TICKET_SLOTS - 1)];
+	__atomic_store_n(&next->turn, ticket + 1, __ATOMIC_SEQ_CST);
+	if(__atomic_load_n(&next->parked, __ATOMIC_SEQ_CST))
+		futex_wake((int*)&next->turn, INT_MAX); //Several tickets may share the slot, each checks its own number
+	return inside;
+}
+
+/*************************************************
+ * Function: tg_exit
+ * Description: Leaves the gate. The last of a full group lets the head of the line in.
+ * Params: Ticket_gate pointer
+ * Returns: None
+ * Pre-conditions: Calling thread is inside the gate
+ * Post-conditions: Calling thread is outside the gate
+ * **********************************************/
+void tg_exit(Ticket_gate* tg)
+{
+	gate_exit(&tg->gate);
+}
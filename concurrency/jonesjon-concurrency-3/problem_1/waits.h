@@ -0,0 +1,110 @@
+#pragma once
+
+//////////////////////////////////////////////////////
+// Per thread admission wait samples and percentiles.
+// Each thread owns its Wait_stats, so recording needs no synchronization.
+//////////////////////////////////////////////////////
+
+#include <stdlib.h>
+#include <time.h>
+#include <limits.h>
+
+typedef struct Wait_stats {
+	unsigned int* us; //Wait of every admission in microseconds
+	int count;
+	int capacity;
+}Wait_stats;
+
+/*************************************************
+ * Function: now_us
+ * Description: Reads the monotonic clock
+ * Params: None
+ * Returns: Microseconds since an arbitrary fixed point
+ * Pre-conditions: None
+ * Post-conditions: None
+ * **********************************************/
+unsigned long long now_us()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+/*************************************************
+ * Function: ws_add
+ * Description: Records one admission wait, growing the sample array as needed
+ * Params: Wait_stats pointer, wait in microseconds
+ * Returns: None
+ * Pre-conditions: Wait_stats was zeroed before first use
+ * Post-conditions: Sample is stored
+ * **********************************************/
+void ws_add(Wait_stats* ws, unsigned long long us)
+{
+	if(ws->count == ws->capacity)
+	{
+		ws->capacity = ws->capacity ? ws->capacity * 2 : 1024;
+		ws->us = (unsigned int*)realloc(ws->us, sizeof(unsigned int)*ws->capacity);
+	}
+	ws->us[ws->count++] = us > UINT_MAX ? UINT_MAX : (unsigned int)us;
+}
+
+/*************************************************
+ * Function: ws_compare
+ * Description: qsort comparator for wait samples
+ * Params: Two unsigned int pointers
+ * Returns: Negative, zero or positive like strcmp
+ * Pre-conditions: None
+ * Post-conditions: None
+ * **********************************************/
+int ws_compare(const void* a, const void* b)
+{
+	unsigned int x = *(const unsigned int*)a, y = *(const unsigned int*)b;
+	return (x > y) - (x < y);
+}
+
+/*************************************************
+ * Function: ws_percentile
+ * Description: Nearest rank percentile of the recorded waits
+ * Params: Wait_stats pointer, percentile between 0 and 100
+ * Returns: Wait in microseconds, 0 if there are no samples
+ * Pre-conditions: ws_sort has been called after the last ws_add
+ * Post-conditions: None
+ * **********************************************/
+unsigned int ws_percentile(Wait_stats* ws, double p)
+{
+	if(ws->count == 0)
+		return 0;
+	int rank = (int)(p / 100.0 * ws->count + 0.5);
+	if(rank < 1)
+		rank = 1;
+	if(rank > ws->count)
+		rank = ws->count;
+	return ws->us[rank - 1];
+}
+
+/*************************************************
+ * Function: ws_sort
+ * Description: Sorts the samples so percentiles can be read
+ * Params: Wait_stats pointer
+ * Returns: None
+ * Pre-conditions: Nobody is still adding samples
+ * Post-conditions: Samples are in ascending order
+ * **********************************************/
+void ws_sort(Wait_stats* ws)
+{
+	qsort(ws->us, ws->count, sizeof(unsigned int), ws_compare);
+}
+
+/*************************************************
+ * Function: ws_merge
+ * Description: Appends every sample of one thread's stats to another (for the all threads row)
+ * Params: Destination Wait_stats pointer, source Wait_stats pointer
+ * Returns: None
+ * Pre-conditions: Nobody is still adding samples to src
+ * Post-conditions: dst holds its old samples plus src's
+ * **********************************************/
+void ws_merge(Wait_stats* dst, Wait_stats* src)
+{
+	int i; for(i = 0; i < src->count; i++)
+		ws_add(dst, src->us[i]);
+}
@@ -0,0 +1,186 @@
+#pragma once
+
+//////////////////////////////////////////////////////
+// Hand over hand (lock coupling) list with a lock in every node.
+//
+// Searchers and deleters walk from a sentinel head, always locking the next node before letting go
+// of the current one, so nobody can unlink the node they are standing on. A deleter holds just the
+// two nodes around the one it removes: deleters working in different parts of the list, searchers
+// behind or ahead of them, and inserters at the tail all run at the same time.
+//
+// Inserters go straight to the tail without walking. The tail pointer only changes while holding the
+// lock of the node it points to, so an inserter locks the node it read, and retries if that node was
+// removed or another inserter got there first. Since that node may be unlinked and retired while the
+// inserter waits for its lock, inserters run inside an epoch read section and deleters retire
+// removed nodes to the epoch reclaimer instead of freeing them.
+//////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+typedef struct Lock_node {
+	int value;
+	int dead; //Unlinked, an inserter that reached it through a stale tail must retry
+	struct Lock_node* next;
+	pthread_mutex_t lock;
+}Lock_node;
+
+typedef struct Lock_list {
+	Lock_node head; //Sentinel, never removed
+	Lock_node* tail; //Last node (the sentinel when empty)
+	int size;
+}Lock_list;
+
+/*************************************************
+ * Function: ll_init
+ * Description: Sets up an empty list
+ * Params: Lock_list pointer
+ * Returns: None
+ * Pre-conditions: None
+ * Post-conditions: List holds only the sentinel
+ * **********************************************/
+void ll_init(Lock_list* list)
+{
+	list->head.value = 0;
+	list->head.dead = 0;
+	list->head.next = NULL;
+	pthread_mutex_init(&list->head.lock, NULL);
+	list->tail = &list->head;
+	list->size = 0;
+}
+
+/*************************************************
+ * Function: ll_walk
+ * Description: Visits every node hand over hand, optionally printing the values
+ * Params: Lock_list pointer, stream to print to or NULL to just walk
+ * Returns: Number of nodes visited
+ * Pre-conditions: None
+ * Post-conditions: No node lock is held
+ * **********************************************/
+int ll_walk(Lock_list* list, FILE* out)
+{
+	int visited = 0;
+	Lock_node* prev = &list->head;
+	pthread_mutex_lock(&prev->lock);
+	Lock_node* node = prev->next;
+	while(node != NULL)
+	{
+		pthread_mutex_lock(&node->lock);
+		pthread_mutex_unlock(&prev->lock);
+		if(out)
+			fprintf(out, "%d, ", node->value);
+		visited++;
+		prev = node;
+		node = node->next;
+	}
+	pthread_mutex_unlock(&prev->lock);
+	if(out)
+		fprintf(out, "\n");
+	return visited;
+}
+
+/*************************************************
+ * Function: ll_append
+ * Description: Appends a node at the tail, locking only the current last node
+ * Params: Lock_list pointer, integer value to be inserted as new node
+ * Returns: None
+ * Pre-conditions: Caller is inside a read section of the epoch reclaimer deleters retire to
+ * Post-conditions: New node is at the end of the list
+ * **********************************************/
+void ll_append(Lock_list* list, int value)
+{
+	Lock_node* node = (Lock_node*)malloc(sizeof(Lock_node));
+	node->value = value;
+	node->dead = 0;
+	node->next = NULL;
+	pthread_mutex_init(&node->lock, NULL);
+
+	while(1)
+	{
+		Lock_node* tail = __atomic_load_n(&list->tail, __ATOMIC_ACQUIRE);
+		pthread_mutex_lock(&tail->lock);
+		if(!tail->dead && tail->next == NULL)
+		{
+			tail->next = node;
+			__atomic_store_n(&list->tail, node, __ATOMIC_RELEASE);
+			__atomic_fetch_add(&list->size, 1, __ATOMIC_RELAXED);
+			pthread_mutex_unlock(&tail->lock);
+			return;
+		}
+		pthread_mutex_unlock(&tail->lock); //Removed or no longer last, read the tail again
+	}
+}
+
+/*************************************************
+ * Function: ll_unlink
+ * Description: Takes the first node holding the value out of the list, holding only the locks of that node and its predecessor
+ * Params: Lock_list pointer, value to remove
+ * Returns: Unlinked node to retire, or NULL if the value is not in the list
+ * Pre-conditions: None
+ * Post-conditions: No node lock is held
+ * **********************************************/
+Lock_node* ll_unlink(Lock_list* list, int value)
+{
+	Lock_node* prev = &list->head;
+	pthread_mutex_lock(&prev->lock);
+	Lock_node* node = prev->next;
+	while(node != NULL)
+	{
+		pthread_mutex_lock(&node->lock);
+		if(node->value == value)
+		{
+			prev->next = node->next;
+			node->dead = 1;
+			if(__atomic_load_n(&list->tail, __ATOMIC_RELAXED) == node) //Holding node's lock, so the tail can not move under us
+				__atomic_store_n(&list->tail, prev, __ATOMIC_RELEASE);
+			__atomic_fetch_sub(&list->size, 1, __ATOMIC_RELAXED);
+			pthread_mutex_unlock(&node->lock);
+			pthread_mutex_unlock(&prev->lock);
+			return node;
+		}
+		pthread_mutex_unlock(&prev->lock);
+		prev = node;
+		node = node->next;
+	}
+	pthread_mutex_unlock(&prev->lock);
+	return NULL;
+}
+
+/*************************************************
+ * Function: ll_free_node
+ * Description: Frees one unlinked node (the reclaim function for the epoch reclaimer)
+ * Params: Reclaim context (unused), Lock_node pointer
+ * Returns: None
+ * Pre-conditions: Nobody can reach the node anymore
+ * Post-conditions: Node is freed
+ * **********************************************/
+void ll_free_node(void* ctx, void* ptr)
+{
+	(void)ctx;
+	Lock_node* node = (Lock_node*)ptr;
+	pthread_mutex_destroy(&node->lock);
+	free(node);
+}
+
+/*************************************************
+ * Function: ll_free
+ * Description: Deallocates all list items
+ * Params: Lock_list pointer
+ * Returns: None
+ * Pre-conditions: No thread is using the list
+ * Post-conditions: All nodes deallocated and the list is empty
+ * **********************************************/
+void ll_free(Lock_list* list)
+{
+	Lock_node* node = list->head.next;
+	while(node != NULL)
+	{
+		Lock_node* next = node->next;
+		ll_free_node(NULL, node);
+		node = next;
+	}
+	list->head.next = NULL;
+	list->tail = &list->head;
+	list->size = 0;
+}
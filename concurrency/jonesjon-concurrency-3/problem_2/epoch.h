@@ -0,0 +1,223 @@
+#pragma once
+
+//////////////////////////////////////////////////////
+// Epoch based memory reclamation.
+//
+// A global epoch counter only ever moves forward. A reader announces the epoch it saw on entry in
+// its own cache line aligned record and clears it on exit, so a read section costs two stores and
+// a fence and never writes anything another reader touches.
+//
+// A writer that unlinks a node can not free it right away since readers may still be standing on
+// it. It retires the node instead, tagged with the current epoch. Once every thread inside a read
+// section has seen the current epoch, the epoch is bumped. A node retired in epoch e is unreachable
+// for anybody who entered in e+1 or later, so it is freed once the global epoch reaches e+2.
+// Writers never wait for readers: a slow reader only delays when retired nodes get freed.
+//////////////////////////////////////////////////////
+
+#include <stdlib.h>
+
+#define EPOCH_MAX_THREADS 256
+#define EPOCH_BATCH 64 //Retired nodes a thread collects before it tries to advance the epoch and free
+
+typedef struct Retired {
+	void* ptr;
+	unsigned long epoch; //Global epoch when the node was retired
+}Retired;
+
+typedef struct Epoch_record {
+	unsigned long state; //(epoch << 1) | 1 while inside a read section, 0 outside
+	Retired* retired; //Nodes this thread retired that are not freed yet, oldest first
+	int count;
+	int capacity;
+	int since_collect;
+	void* ctx; //Handed to reclaim
+}__attribute__((aligned(64))) Epoch_record;
+
+typedef struct Epoch {
+	unsigned long global;
+	int threads; //Records handed out
+	void (*reclaim)(void*, void*); //Frees a retired node, given the retiring thread's context
+	unsigned long long freed;
+	Epoch_record rec[EPOCH_MAX_THREADS];
+}Epoch;
+
+/*************************************************
+ * Function: epoch_new
+ * Description: Allocates a reclaimer in epoch 0 with no registered threads
+ * Params: Function that frees a retired node (called with the context the retiring thread registered and the node)
+ * Returns: Epoch pointer
+ * Pre-conditions: None
+ * Post-conditions: Every record is outside a read section and has nothing retired
+ * **********************************************/
+Epoch* epoch_new(void (*reclaim)(void*, void*))
+{
+	Epoch* ep = (Epoch*)aligned_alloc(64, sizeof(Epoch));
+	ep->global = 0;
+	ep->threads = 0;
+	ep->reclaim = reclaim;
+	ep->freed = 0;
+	int i; for(i = 0; i < EPOCH_MAX_THREADS; i++)
+	{
+		ep->rec[i].state = 0;
+		ep->rec[i].retired = NULL;
+		ep->rec[i].count = 0;
+		ep->rec[i].capacity = 0;
+		ep->rec[i].since_collect = 0;
+		ep->rec[i].ctx = NULL;
+	}
+	return ep;
+}
+
+/*************************************************
+ * Function: epoch_register
+ * Description: Hands the calling thread its own record
+ * Params: Epoch pointer, context passed to the reclaim function for nodes this thread retires (must outlive the reclaimer)
+ * Returns: Record to pass to the other functions, NULL if EPOCH_MAX_THREADS threads already registered
+ * Pre-conditions: None
+ * Post-conditions: Record is counted when advancing the epoch
+ * **********************************************/
+Epoch_record* epoch_register(Epoch* ep, void* ctx)
+{
+	int i = __atomic_fetch_add(&ep->threads, 1, __ATOMIC_RELAXED);
+	if(i >= EPOCH_MAX_THREADS)
+		return NULL;
+	ep->rec[i].ctx = ctx;
+	return &ep->rec[i];
+}
+
+/*************************************************
+ * Function: epoch_enter
+ * Description: Starts a read section. Nodes reachable from here on are not freed until epoch_exit.
+ * Params: Epoch pointer, record of the calling thread
+ * Returns: None
+ * Pre-conditions: Not already inside a read section
+ * Post-conditions: Record shows the epoch seen on entry
+ * **********************************************/
+void epoch_enter(Epoch* ep, Epoch_record* rec)
+{
+	unsigned long e = __atomic_load_n(&ep->global, __ATOMIC_RELAXED);
+	__atomic_store_n(&rec->state, (e << 1) | 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_SEQ_CST); //Announce before reading any list pointer
+}
+
+/*************************************************
+ * Function: epoch_exit
+ * Description: Ends a read section
+ * Params: Record of the calling thread
+ * Returns: None
+ * Pre-conditions: Inside a read section
+ * Post-conditions: Record no longer holds back the epoch
+ * **********************************************/
+void epoch_exit(Epoch_record* rec)
+{
+	__atomic_store_n(&rec->state, 0, __ATOMIC_RELEASE);
+}
+
+/*************************************************
+ * Function: epoch_try_advance
+ * Description: Bumps the global epoch if every thread inside a read section has seen the current one
+ * Params: Epoch pointer
+ * Returns: Global epoch after the attempt
+ * Pre-conditions: None
+ * Post-conditions: None
+ * **********************************************/
+unsigned long epoch_try_advance(Epoch* ep)
+{
+	__atomic_thread_fence(__ATOMIC_SEQ_CST); //Our unlinks are visible before we look at the readers
+	unsigned long e = __atomic_load_n(&ep->global, __ATOMIC_RELAXED);
+	int threads = __atomic_load_n(&ep->threads, __ATOMIC_RELAXED);
+	if(threads > EPOCH_MAX_THREADS)
+		threads = EPOCH_MAX_THREADS;
+
+	int i; for(i = 0; i < threads; i++)
+	{
+		unsigned long state = __atomic_load_n(&ep->rec[i].state, __ATOMIC_ACQUIRE);
+		if((state & 1) && (state >> 1) != e)
+			return e; //Somebody is still reading in an older epoch
+	}
+	if(__atomic_compare_exchange_n(&ep->global, &e, e + 1, 0, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+		return e + 1;
+	return e; //Somebody else advanced it, e holds the new value
+}
+
+/*************************************************
+ * Function: epoch_collect
+ * Description: Tries to advance the epoch, then frees every node this thread retired at least two epochs ago
+ * Params: Epoch pointer, record of the calling thread
+ * Returns: None
+ * Pre-conditions: None (from inside a read section nothing retired during it can be freed yet)
+ * Post-conditions: Only nodes that readers may still hold stay retired
+ * **********************************************/
+void epoch_collect(Epoch* ep, Epoch_record* rec)
+{
+	unsigned long e = epoch_try_advance(ep);
+	int done = 0;
+	while(done < rec->count && rec->retired[done].epoch + 2 <= e)
+		ep->reclaim(rec->ctx, rec->retired[done++].ptr);
+
+	int i; for(i = done; i < rec->count; i++)
+		rec->retired[i - done] = rec->retired[i];
+	__atomic_store_n(&rec->count, rec->count - done, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&ep->freed, done, __ATOMIC_RELAXED);
+	rec->since_collect = 0;
+}
+
+/*************************************************
+ * Function: epoch_retire
+ * Description: Hands over a node that has been unlinked. It is freed once no reader can still hold it.
+ * Params: Epoch pointer, record of the calling thread, node
+ * Returns: None
+ * Pre-conditions: Node is no longer reachable from the list
+ * Post-conditions: Node is freed now or by a later call on this record
+ * **********************************************/
+void epoch_retire(Epoch* ep, Epoch_record* rec, void* ptr)
+{
+	if(rec->count == rec->capacity)
+	{
+		rec->capacity = rec->capacity ? rec->capacity * 2 : EPOCH_BATCH * 2;
+		rec->retired = (Retired*)realloc(rec->retired, sizeof(Retired)*rec->capacity);
+	}
+	rec->retired[rec->count].ptr = ptr;
+	rec->retired[rec->count].epoch = __atomic_load_n(&ep->global, __ATOMIC_RELAXED);
+	__atomic_store_n(&rec->count, rec->count + 1, __ATOMIC_RELAXED);
+
+	if(++rec->since_collect >= EPOCH_BATCH)
+		epoch_collect(ep, rec);
+}
+
+/*************************************************
+ * Function: epoch_pending
+ * Description: Counts retired nodes that have not been freed yet, over every thread
+ * Params: Epoch pointer
+ * Returns: Number of nodes waiting to be freed
+ * Pre-conditions: None
+ * Post-conditions: None
+ * **********************************************/
+long epoch_pending(Epoch* ep)
+{
+	long pending = 0;
+	int threads = __atomic_load_n(&ep->threads, __ATOMIC_RELAXED);
+	int i; for(i = 0; i < threads && i < EPOCH_MAX_THREADS; i++)
+		pending += __atomic_load_n(&ep->rec[i].count, __ATOMIC_RELAXED);
+	return pending;
+}
+
+/*************************************************
+ * Function: epoch_free
+ * Description: Frees every retired node and the reclaimer itself
+ * Params: Epoch pointer
+ * Returns: None
+ * Pre-conditions: No thread is reading or retiring anymore
+ * Post-conditions: Epoch pointer is invalid
+ * **********************************************/
+void epoch_free(Epoch* ep)
+{
+	int i, j;
+	for(i = 0; i < ep->threads && i < EPOCH_MAX_THREADS; i++)
+	{
+		for(j = 0; j < ep->rec[i].count; j++)
+			ep->reclaim(ep->rec[i].ctx, ep->rec[i].retired[j].ptr);
+		free(ep->rec[i].retired);
+	}
+	free(ep);
+}
@@ -0,0 +1,232 @@
+#pragma once
+
+//////////////////////////////////////////////////////
+// Hazard pointer memory reclamation.
+//
+// Every reader owns a cache line aligned record with HAZARD_SLOTS published pointers. Before it
+// dereferences a node it publishes the node's address, then checks that the link it came through
+// still points there. From then on the node can not be freed until the slot is overwritten.
+//
+// A writer that unlinks a node retires it into its own list. When the list gets long it scans every
+// published hazard and frees each retired node nobody has published; the rest wait for the next
+// scan. Unlike epochs this bounds how much memory is waiting: a reader stalled in the middle of a
+// traversal only pins the (at most HAZARD_SLOTS) nodes it has published, never everything retired
+// after it.
+//////////////////////////////////////////////////////
+
+#include <stdlib.h>
+
+#define HAZARD_MAX_THREADS 256
+#define HAZARD_SLOTS 2 //Hand over hand traversal needs the current node and the next one
+#define HAZARD_BATCH 64 //Retired nodes a thread always allows itself before scanning
+
+typedef struct Hazard_record {
+	void* hp[HAZARD_SLOTS]; //Nodes this thread is touching, NULL for unused slots
+	void** retired; //Nodes this thread retired that are not freed yet
+	int count;
+	int capacity;
+	void* ctx; //Handed to reclaim
+}__attribute__((aligned(64))) Hazard_record;
+
+typedef struct Hazard {
+	int threads; //Records handed out
+	void (*reclaim)(void*, void*); //Frees a retired node, given the retiring thread's context
+	unsigned long long freed;
+	Hazard_record rec[HAZARD_MAX_THREADS];
+}Hazard;
+
+/*************************************************
+ * Function: hazard_new
+ * Description: Allocates a reclaimer with no registered threads
+ * Params: Function that frees a retired node (called with the context the retiring thread registered and the node)
+ * Returns: Hazard pointer
+ * Pre-conditions: None
+ * Post-conditions: Every slot is empty and nothing is retired
+ * **********************************************/
+Hazard* hazard_new(void (*reclaim)(void*, void*))
+{
+	Hazard* hz = (Hazard*)aligned_alloc(64, sizeof(Hazard));
+	hz->threads = 0;
+	hz->reclaim = reclaim;
+	hz->freed = 0;
+	int i, j;
+	for(i = 0; i < HAZARD_MAX_THREADS; i++)
+	{
+		for(j = 0; j < HAZARD_SLOTS; j++)
+			hz->rec[i].hp[j] = NULL;
+		hz->rec[i].retired = NULL;
+		hz->rec[i].count = 0;
+		hz->rec[i].capacity = 0;
+		hz->rec[i].ctx = NULL;
+	}
+	return hz;
+}
+
+/*************************************************
+ * Function: hazard_register
+ * Description: Hands the calling thread its own record
+ * Params: Hazard pointer, context passed to the reclaim function for nodes this thread retires (must outlive the reclaimer)
+ * Returns: Record to pass to the other functions, NULL if HAZARD_MAX_THREADS threads already registered
+ * Pre-conditions: None
+ * Post-conditions: Record's slots are checked by every scan
+ * **********************************************/
+Hazard_record* hazard_register(Hazard* hz, void* ctx)
+{
+	int i = __atomic_fetch_add(&hz->threads, 1, __ATOMIC_RELAXED);
+	if(i >= HAZARD_MAX_THREADS)
+		return NULL;
+	hz->rec[i].ctx = ctx;
+	return &hz->rec[i];
+}
+
+/*************************************************
+ * Function: hazard_protect
+ * Description: Reads a link and publishes what it points to, retrying until the link is seen unchanged after publishing
+ * Params: Record of the calling thread, slot to publish in, address of the link
+ * Returns: Node the link points to (may be NULL). It can not be freed until the slot is reused or cleared.
+ * Pre-conditions: The memory holding the link is itself protected (or is not a node)
+ * Post-conditions: Slot holds the returned node
+ * **********************************************/
+void* hazard_protect(Hazard_record* rec, int slot, void** link)
+{
+	void* p = __atomic_load_n(link, __ATOMIC_RELAXED);
+	while(1)
+	{
+		__atomic_store_n(&rec->hp[slot], p, __ATOMIC_RELAXED);
+		__atomic_thread_fence(__ATOMIC_SEQ_CST); //Publish before checking, pairs with the fence in hazard_scan
+		void* again = __atomic_load_n(link, __ATOMIC_ACQUIRE);
+		if(again == p)
+			return p;
+		p = again;
+	}
+}
+
+/*************************************************
+ * Function: hazard_clear
+ * Description: Empties every slot of the record
+ * Params: Record of the calling thread
+ * Returns: None
+ * Pre-conditions: None
+ * Post-conditions: Thread no longer holds back any node
+ * **********************************************/
+void hazard_clear(Hazard_record* rec)
+{
+	int i; for(i = 0; i < HAZARD_SLOTS; i++)
+		__atomic_store_n(&rec->hp[i], NULL, __ATOMIC_RELEASE);
+}
+
+/*************************************************
+ * Function: hazard_compare
+ * Description: qsort and bsearch comparator for pointers
+ * Params: Two pointers to void*
+ * Returns: Negative, zero or positive like strcmp
+ * Pre-conditions: None
+ * Post-conditions: None
+ * **********************************************/
+int hazard_compare(const void* a, const void* b)
+{
+	unsigned long x = (unsigned long)*(void* const*)a, y = (unsigned long)*(void* const*)b;
+	return (x > y) - (x < y);
+}
+
+/*************************************************
+ * Function: hazard_scan
+ * Description: Frees every node this thread retired that no thread has published
+ * Params: Hazard pointer, record of the calling thread
+ * Returns: None
+ * Pre-conditions: None
+ * Post-conditions: At most threads * HAZARD_SLOTS nodes stay retired
+ * **********************************************/
+void hazard_scan(Hazard* hz, Hazard_record* rec)
+{
+	__atomic_thread_fence(__ATOMIC_SEQ_CST); //Our unlinks are visible before we look at the hazards
+	int threads = __atomic_load_n(&hz->threads, __ATOMIC_RELAXED);
+	if(threads > HAZARD_MAX_THREADS)
+		threads = HAZARD_MAX_THREADS;
+
+	void** hazards = (void**)malloc(sizeof(void*)*(threads*HAZARD_SLOTS + 1));
+	int count = 0, i, j;
+	for(i = 0; i < threads; i++)
+	{
+		for(j = 0; j < HAZARD_SLOTS; j++)
+		{
+			void* p = __atomic_load_n(&hz->rec[i].hp[j], __ATOMIC_ACQUIRE);
+			if(p != NULL)
+				hazards[count++] = p;
+		}
+	}
+	qsort(hazards, count, sizeof(void*), hazard_compare);
+
+	int kept = 0;
+	for(i = 0; i < rec->count; i++)
+	{
+		if(bsearch(&rec->retired[i], hazards, count, sizeof(void*), hazard_compare))
+			rec->retired[kept++] = rec->retired[i];
+		else
+			hz->reclaim(rec->ctx, rec->retired[i]);
+	}
+	__atomic_fetch_add(&hz->freed, rec->count - kept, __ATOMIC_RELAXED);
+	__atomic_store_n(&rec->count, kept, __ATOMIC_RELAXED);
+	free(hazards);
+}
+
+/*************************************************
+ * Function: hazard_retire
+ * Description: Hands over a node that has been unlinked. It is freed by a scan once no slot holds it.
+ * Params: Hazard pointer, record of the calling thread, node
+ * Returns: None
+ * Pre-conditions: Node is no longer reachable from the list
+ * Post-conditions: Node is freed now or by a later scan of this record
+ * **********************************************/
+void hazard_retire(Hazard* hz, Hazard_record* rec, void* ptr)
+{
+	if(rec->count == rec->capacity)
+	{
+		rec->capacity = rec->capacity ? rec->capacity * 2 : HAZARD_BATCH * 2;
+		rec->retired = (void**)realloc(rec->retired, sizeof(void*)*rec->capacity);
+	}
+	rec->retired[rec->count] = ptr;
+	__atomic_store_n(&rec->count, rec->count + 1, __ATOMIC_RELAXED);
+
+	//Scanning once the list outgrows every possible hazard frees at least half of it each time
+	int threshold = 2 * __atomic_load_n(&hz->threads, __ATOMIC_RELAXED) * HAZARD_SLOTS;
+	if(rec->count >= (threshold > HAZARD_BATCH ? threshold : HAZARD_BATCH))
+		hazard_scan(hz, rec);
+}
+
+/*************************************************
+ * Function: hazard_pending
+ * Description: Counts retired nodes that have not been freed yet, over every thread
+ * Params: Hazard pointer
+ * Returns: Number of nodes waiting to be freed
+ * Pre-conditions: None
+ * Post-conditions: None
+ * **********************************************/
+long hazard_pending(Hazard* hz)
+{
+	long pending = 0;
+	int threads = __atomic_load_n(&hz->threads, __ATOMIC_RELAXED);
+	int i; for(i = 0; i < threads && i < HAZARD_MAX_THREADS; i++)
+		pending += __atomic_load_n(&hz->rec[i].count, __ATOMIC_RELAXED);
+	return pending;
+}
+
+/*************************************************
+ * Function: hazard_free
+ * Description: Frees every retired node and the reclaimer itself
+ * Params: Hazard pointer
+ * Returns: None
+ * Pre-conditions: No thread is reading or retiring anymore
+ * Post-conditions: Hazard pointer is invalid
+ * **********************************************/
+void hazard_free(Hazard* hz)
+{
+	int i, j;
+	for(i = 0; i < hz->threads && i < HAZARD_MAX_THREADS; i++)
+	{
+		for(j = 0; j < hz->rec[i].count; j++)
+			hz->reclaim(hz->rec[i].ctx, hz->rec[i].retired[j]);
+		free(hz->rec[i].retired);
+	}
+	free(hz);
+}
@@ -0,0 +1,257 @@
+#pragma once
+
+//////////////////////////////////////////////////////
+// Doubly linked list with a header that tracks the head, the tail and the size.
+//
+// Appending and removing the last node are O(1): the tail is always at hand and every node knows
+// its predecessor. Everything that has to walk the list does so with a loop, never recursion, so a
+// long list can not overflow the stack.
+//
+// Nodes come from the calling thread's pool cache, or from malloc when the cache is NULL.
+//
+// None of these functions synchronize. Callers enforce the searcher/inserter/deleter exclusion.
+//////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "pool.h"
+
+typedef struct Node {
+	int value;
+	unsigned int version; //Odd while a deleter changes next or once the node is unlinked (optimistic.h only)
+	struct Node* next;
+	struct Node* prev;
+}Node;
+
+typedef struct List {
+	Node* head;
+	Node* tail;
+	int size;
+	unsigned int version; //Odd while a deleter changes head (optimistic.h only)
+}List;
+
+/*************************************************
+ * Function: list_init
+ * Description: Sets up an empty list
+ * Params: List pointer
+ * Returns: None
+ * Pre-conditions: None
+ * Post-conditions: List has no nodes
+ * **********************************************/
+void list_init(List* list)
+{
+	list->head = NULL;
+	list->tail = NULL;
+	list->size = 0;
+	list->version = 0;
+}
+
+/*************************************************
+ * Function: node_new
+ * Description: Allocates a node
+ * Params: Pool cache of the calling thread, or NULL to use malloc
+ * Returns: Uninitialized node
+ * Pre-conditions: The cache's pool was created for sizeof(Node)
+ * Post-conditions: None
+ * **********************************************/
+Node* node_new(Pool_cache* cache)
+{
+	if(cache)
+		return (Node*)pool_alloc(cache);
+	return (Node*)malloc(sizeof(Node));
+}
+
+/*************************************************
+ * Function: node_free
+ * Description: Deallocates a node
+ * Params: Pool cache of the calling thread, or NULL if the node came from malloc
+ * Returns: None
+ * Pre-conditions: Node is no longer reachable
+ * Post-conditions: Node may be handed out again
+ * **********************************************/
+void node_free(Pool_cache* cache, Node* node)
+{
+	if(cache)
+		pool_free(cache, node);
+	else
+		free(node);
+}
+
+/*************************************************
+ * Function: show_list
+ * Description: Prints out the contents of a linked list. Used by the searcher thread to simulate searching (Reads).
+ * Params: List pointer, stream to print to or NULL to just walk the list
+ * Returns: Number of nodes visited
+ * Pre-conditions: None
+ * Post-conditions: Linked list is printed out or if list is empty a newline is printed
+ * **********************************************/
+int show_list(List* list, FILE* out)
+{
+	int visited = 0;
+	Node* node;
+	for(node = list->head; node != NULL; node = node->next)
+	{
+		if(out)
+			fprintf(out, "%d, ", node->value);
+		visited++;
+	}
+	if(out)
+		fprintf(out, "\n");
+	return visited;
+}
+
+/*************************************************
+ * Function: insert
+ * Description: Appends a node onto the end of the list in constant time. Creates a head if the list is empty.
+ * Params: List pointer, integer value to be inserted as new node, pool cache (NULL for malloc)
+ * Returns: None
+ * Pre-conditions: None
+ * Post-conditions: New node is allocated memory and added to the end of the list
+ * **********************************************/
+void insert(List* list, int value, Pool_cache* cache)
+{
+	Node* node = node_new(cache);
+	node->value = value;
+	node->next = NULL;
+	node->prev = list->tail;
+
+	if(list->tail == NULL)
+		list->head = node;
+	else
+		list->tail->next = node;
+	list->tail = node;
+	list->size++;
+}
+
+/*************************************************
+ * Function: append_many
+ * Description: Appends several values in order, touching the header once instead of once per value
+ * Params: List pointer, array of values, number of values, pool cache (NULL for malloc)
+ * Returns: Number of nodes appended
+ * Pre-conditions: values holds n values
+ * Post-conditions: Values are at the end of the list in array order
+ * **********************************************/
+int append_many(List* list, int* values, int n, Pool_cache* cache)
+{
+	Node* tail = list->tail;
+	int i; for(i = 0; i < n; i++)
+	{
+		Node* node = node_new(cache);
+		node->value = values[i];
+		node->next = NULL;
+		node->prev = tail;
+		if(tail == NULL)
+			list->head = node;
+		else
+			tail->next = node;
+		tail = node;
+	}
+	list->tail = tail;
+	list->size += n;
+	return n;
+}
+
+/*************************************************
+ * Function: unlink_node
+ * Description: Takes a node out of the list and deallocates it
+ * Params: List pointer, node in the list, pool cache (NULL for malloc)
+ * Returns: None
+ * Pre-conditions: node is in list
+ * Post-conditions: Neighbours (or head/tail) point around the node and it has been freed
+ * **********************************************/
+void unlink_node(List* list, Node* node, Pool_cache* cache)
+{
+	if(node->prev == NULL)
+		list->head = node->next;
+	else
+		node->prev->next = node->next;
+
+	if(node->next == NULL)
+		list->tail = node->prev;
+	else
+		node->next->prev = node->prev;
+
+	list->size--;
+	node_free(cache, node);
+}
+
+/*************************************************
+ * Function: delete
+ * Description: Deletes the first node in the list holding the value passed in. Deallocates node deleted.
+ * Params: List pointer, integer value corresponding to the node you want deleted from the list, pool cache (NULL for malloc)
+ * Returns: 1 if a node was deleted, 0 if the value is not in the list
+ * Pre-conditions: None
+ * Post-conditions: Node corresponding to value has been removed and deallocated or no change if value is not present in list.
+ * **********************************************/
+int delete(List* list, int value, Pool_cache* cache)
+{
+	Node* node;
+	for(node = list->head; node != NULL; node = node->next)
+	{
+		if(node->value == value)
+		{
+			unlink_node(list, node, cache);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/*************************************************
+ * Function: delete_if
+ * Description: Deletes every node whose value the predicate accepts, in one pass. Deallocates nodes deleted.
+ * Params: List pointer, predicate (value, context) returning non zero to delete, context handed to the predicate, pool cache (NULL for malloc)
+ * Returns: Number of nodes deleted
+ * Pre-conditions: None
+ * Post-conditions: No node left in the list is accepted by the predicate
+ * **********************************************/
+int delete_if(List* list, int (*pred)(int, void*), void* ctx, Pool_cache* cache)
+{
+	int deleted = 0;
+	Node* node = list->head;
+	while(node != NULL)
+	{
+		Node* next = node->next;
+		if(pred(node->value, ctx))
+		{
+			unlink_node(list, node, cache);
+			deleted++;
+		}
+		node = next;
+	}
+	return deleted;
+}
+
+/*************************************************
+ * Function: delete_end
+ * Description: Deletes the node at the end of the list in constant time. Deallocates node deleted.
+ * Params: List pointer, pool cache (NULL for malloc)
+ * Returns: None
+ * Pre-conditions: None
+ * Post-conditions: End of the linked list is deleted and deallocated, nothing happens if the list is empty.
+ * **********************************************/
+void delete_end(List* list, Pool_cache* cache)
+{
+	if(list->tail != NULL)
+		unlink_node(list, list->tail, cache);
+}
+
+/*************************************************
+ * Function: free_list
+ * Description: Deallocates all list items
+ * Params: List pointer
+ * Returns: None
+ * Pre-conditions: Nodes came from malloc (pooled nodes are released all at once with pool_destroy)
+ * Post-conditions: All nodes deallocated and the list is empty
+ * **********************************************/
+void free_list(List* list)
+{
+	Node* node = list->head;
+	while(node != NULL)
+	{
+		Node* next = node->next;
+		free(node);
+		node = next;
+	}
+	list_init(list);
+}
@@ -6,14 +6,87 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <unistd.h>
+#include <string.h>
+#include <time.h>
 #include <pthread.h>
 #include <semaphore.h>
 #include "mt19937ar.h"
+#include "list.h"
+#include "rculist.h"
+#include "epoch.h"
+#include "hazard.h"
+#include "coupling.h"
+#include "pool.h"
+#include "unrolled.h"
+#include "skiplist.h"
+#include "snapshot.h"
+#include "mapped.h"
+#include "optimistic.h"
+#include "waits.h"
 
-typedef struct Node {
-	int value;
-	struct Node* next;
-}Node;
+#define BENCH_SEARCHERS 4 //Default benchmark thread counts
+#define BENCH_INSERTERS 1
+#define BENCH_DELETERS 1
+#define KEYS 101 //Default range of values threads insert, look up and delete (0 to KEYS - 1)
+#define SHARDS 8 //Default number of lists in sharded mode
+#define IMAGE "list.img" //Default file holding the list in mapped mode
+
+//How the searchers, inserters and deleters share the list
+enum list_modes {
+	MODE_LIGHTSWITCH, //Searchers and inserters each behind a lightswitch, deleters exclude both
+	MODE_RCU, //Searchers take no locks, deleters retire nodes to a reclaimer
+	MODE_COUPLING, //A lock in every node, threads lock hand over hand and deleters remove by value
+	MODE_UNROLLED, //Lightswitch protocol over a list with a cache line of values per node
+	MODE_SKIPLIST, //Ordered set: searchers look values up, inserters add them, deleters remove them, all concurrently
+	MODE_SNAPSHOT, //Searchers walk an immutable snapshot of the list while writers publish new versions
+	MODE_SHARDED, //Values are split by hash over several lists, each with its own lightswitch protocol
+	MODE_MAPPED, //Lightswitch protocol over a list kept in a memory mapped file that outlives the program
+	MODE_OPTIMISTIC //Searchers take no locks and validate node versions, starting over if a deleter changed what they read
+};
+
+//Labels for each list_modes value, used on the command line and in prints
+const char* mode_names[] = { "lightswitch", "rcu", "coupling", "unrolled", "skiplist", "snapshot", "sharded", "mapped", "optimistic" };
+#define NUM_MODES (int)(sizeof(mode_names)/sizeof(mode_names[0]))
+
+//How rcu mode frees the nodes deleters unlink
+enum reclaimers {
+	RECLAIM_EPOCH, //Freed once every reader has moved two epochs on, cheapest reads
+	RECLAIM_HAZARD //Freed once no reader publishes the node, bounded even if a reader stalls
+};
+
+const char* reclaim_names[] = { "epoch", "hazard" };
+#define NUM_RECLAIMERS (int)(sizeof(reclaim_names)/sizeof(reclaim_names[0]))
+
+//Where list nodes come from (coupling, skiplist and snapshot modes always use malloc)
+enum allocators {
+	ALLOC_MALLOC, //malloc and free for every node
+	ALLOC_POOL //Per thread caches over slabs, no malloc or free once warmed up
+};
+
+const char* alloc_names[] = { "malloc", "pool" };
+#define NUM_ALLOCATORS (int)(sizeof(alloc_names)/sizeof(alloc_names[0]))
+
+//Who goes first when deleters and the other roles want the list (lightswitch, rcu and unrolled modes)
+enum policies {
+	POLICY_READER, //Searchers and inserters keep their lightswitches on as long as more keep arriving, deleters may starve
+	POLICY_FAIR, //Everybody passes a turnstile that a waiting deleter holds, so nobody arriving later overtakes it
+	POLICY_DELETER //The first waiting deleter shuts the turnstile until no deleter is left, searchers and inserters may starve
+};
+
+const char* policy_names[] = { "reader", "fair", "deleter" };
+#define NUM_POLICIES (int)(sizeof(policy_names)/sizeof(policy_names[0]))
+
+//What a benchmark thread does over and over
+enum roles {
+	ROLE_SEARCH,
+	ROLE_INSERT,
+	ROLE_DELETE
+};
+
+const char* role_names[] = { "search", "insert", "delete" };
+#define NUM_ROLES (int)(sizeof(role_names)/sizeof(role_names[0]))
+#define ROLE_MIXED -1 //Benchmark thread that picks the role of every operation from the mix
 
 //Constructed from equivalent python implementation in little book of semaphores page 70
 typedef struct Lightswitch { 
@@ -39,41 +112,136 @@ void ls_unlock(Lightswitch* ls, sem_t* s)
 	sem_post(ls->mutex);
 }
 
-//Arguments for the search thread
-typedef struct Searcher_args {
-	Node** list;
-	Lightswitch* search_switch; 
-	sem_t* no_search;
-	sem_t* talk;
-}Searcher_args;
-
-//Arguments for the insertion threads
-typedef struct Inserter_args {
-	Node** list;
-	Lightswitch* insert_switch;
-	sem_t* insert_mutex;
-	sem_t* no_insert;
-	sem_t* talk;
-}Inserter_args;
+//Semaphores of the searcher/inserter/deleter protocol for one list
+typedef struct Exclusion {
+	Lightswitch search_switch;
+	Lightswitch insert_switch;
+	Lightswitch delete_switch; //Deleter policy: first deleter in shuts the turnstile
+	sem_t insert_mutex;
+	sem_t no_search;
+	sem_t no_insert;
+	sem_t turnstile; //Fair and deleter policies
+	sem_t switch_mutex[3]; //Used by the three lightswitches
+}Exclusion;
+
+//One of the lists in sharded mode, guarded by its own protocol
+typedef struct Shard {
+	Exclusion ex;
+	List list;
+}__attribute__((aligned(64))) Shard;
 
-//Arguments for the deleter threads
-typedef struct Deleter_args {
-	Node** list;
-	sem_t* no_search;
-	sem_t* no_insert;
+//Arguments shared by the searcher, inserter and deleter threads
+typedef struct Args_t {
+	List* list;
+	Lock_list* locked; //The list in coupling mode
+	Unrolled_list* unrolled; //The list in unrolled mode
+	Skip_list* skip; //The set in skiplist mode
+	Versioned_list* versions; //The list in snapshot mode
+	Shard* shards; //The lists in sharded mode
+	int num_shards;
+	Mapped_list* mapped; //The list in mapped mode
+	const char* image; //File it lives in
+	int durable; //1 to msync every change to the image
+	Pool* pool; //NULL when nodes come from malloc
+	Exclusion* ex; //Protocol for list (lightswitch and rcu modes) and unrolled
 	sem_t* talk;
-}Deleter_args;
+	Epoch* epoch;
+	Hazard* hazard;
+	int mode;
+	int reclaim;
+	int allocator;
+	int policy;
+	int batch; //Values per insert and width of the value range per delete, 0 for one value at a time (lightswitch and unrolled modes)
+	int keys; //Values are drawn from 0 to keys - 1
+	int mix[NUM_ROLES]; //Percent of the operations of mixed benchmark threads that go to each role
+	int preload; //Values put in the list before a benchmark starts
+}Args_t;
+
+//Per thread state, set up when the thread starts
+typedef struct Worker {
+	Args_t* args;
+	Epoch_record* epoch; //Reclamation records (rcu mode)
+	Hazard_record* hazard;
+	Pool_cache* cache; //NULL when nodes come from malloc
+	unsigned int seed; //Random state for skip list levels
+	Version_node* snapshot; //Version a searcher is walking (snapshot mode)
+	Shard* shard; //Shard an insert or delete is working on (sharded mode)
+	int id;
+}Worker;
+
+//Arguments for the benchmark threads
+typedef struct Bench_args {
+	Args_t* shared;
+	int role; //ROLE_MIXED to draw every operation from the mix
+	int stall; //1 to stop in the middle of a search until the run is over
+	int* stop; //Set to 1 when the run is over
+	unsigned int seed; //Per thread random state (prng is not thread safe)
+	unsigned long long ops[NUM_ROLES]; //Operations of each role this thread did
+	unsigned long long values[NUM_ROLES]; //Nodes visited, inserted or deleted
+	Wait_stats waits[NUM_ROLES]; //Time spent in begin_search, begin_insert or begin_delete
+	Wait_stats latency[NUM_ROLES]; //Time from the start of an operation to the end of end_search, end_insert or end_delete
+}Bench_args;
+
+//What one benchmark run measured
+typedef struct Bench_result {
+	double elapsed; //Seconds
+	double ops[NUM_ROLES]; //Operations per second of each role
+	double values[NUM_ROLES]; //Nodes visited, inserted or deleted per second by each role
+	long peak; //Most retired nodes waiting to be freed at once
+	long pending; //Retired nodes waiting at the end
+	unsigned long long freed; //Nodes freed by the reclaimer
+	int size; //List length at the end
+	size_t pool_bytes; //Memory taken by pool slabs
+	Wait_stats waits[NUM_ROLES]; //Waits to get at the list of every operation of each role (freed by whoever ran the benchmark)
+	Wait_stats latency[NUM_ROLES]; //Whole operation latencies of each role (freed the same way)
+}Bench_result;
 
 int bit;
 
 //Function prototypes
 unsigned int prng();
-void driver();
-void show_list(Node*); //Searcher function
-void insert(Node**, int); //Inserter function
-void delete(Node**, int); //Deleter function
-void delete_end(Node**);
-void free_list(Node**);
+void driver(int, int, int, int, int, int, int, const char*, int, int, int*, int*, int, int, int, int);
+void setup_list(Args_t*);
+void teardown_list(Args_t*);
+void reclaim_node(void*, void*);
+size_t node_size(Args_t*);
+int list_size(Args_t*);
+int pooled(Args_t*);
+int batches(int);
+int in_range(int, void*);
+const char* mode_label(Args_t*);
+void preload_list(Args_t*);
+void run_bench(Args_t*, int, int*, int, int, Bench_result*);
+void report(const char*, Wait_stats*);
+void bench(Args_t*, int, int*, int, int);
+void sweep(Args_t*, int, int*, int, int);
+void* bench_thread(void*);
+void stall_search(Worker*, int*);
+long pending(Args_t*);
+void worker_init(Worker*, Args_t*);
+void ex_init(Exclusion*);
+void enter_turnstile(Exclusion*, int);
+void leave_turnstile(Exclusion*, int);
+void search_lock(Exclusion*, int);
+void search_unlock(Exclusion*);
+void insert_lock(Exclusion*, int);
+void insert_unlock(Exclusion*);
+void delete_lock(Exclusion*, int, int);
+void delete_unlock(Exclusion*, int, int);
+Shard* shard_of(Args_t*, int);
+int shard_scan(Worker*, FILE*);
+
+void begin_search(Worker*);
+void end_search(Worker*);
+int search(Worker*, int, FILE*);
+void begin_insert(Worker*, int);
+void end_insert(Worker*);
+int insert_value(Worker*, int);
+void begin_delete(Worker*, int);
+void end_delete(Worker*);
+int delete_value(Worker*, int);
+int insert_values(Worker*, int*, int);
+int delete_range(Worker*, int, int);
 
 void* searcher(void*);
 void* inserter(void*);
@@ -81,8 +249,142 @@ void* deleter(void*);
 
 pthread_t* get_threads(int, void*, void*);
 
-int main()
+int main(int argc, char** argv)
 {
+	int mode = MODE_LIGHTSWITCH;
+	int reclaim = RECLAIM_EPOCH;
+	int bench_seconds = 0;
+	int threads[NUM_ROLES] = { BENCH_SEARCHERS, BENCH_INSERTERS, BENCH_DELETERS };
+	int stall = 0;
+	int sweep_threads = 0;
+	int mode_set = 0;
+	int allocator = ALLOC_MALLOC;
+	int policy = POLICY_READER;
+	int keys = KEYS;
+	int batch = 0;
+	int shards = SHARDS;
+	const char* image = IMAGE;
+	int durable = 0;
+	int image_set = 0;
+	int mix[NUM_ROLES] = { 0, 0, 0 };
+	int mixed = 0;
+	int preload = 0;
+	int opt, m;
+	while((opt = getopt(argc, argv, "m:r:a:p:k:B:H:f:Fb:s:i:d:M:t:P:zS:")) != -1)
+	{
+		if(opt == 'm')
+		{
+			mode = -1;
+			for(m = 0; m < NUM_MODES; m++)
+			{
+				if(strcmp(optarg, mode_names[m]) == 0)
+					mode = m;
+			}
+			if(mode == -1)
+				opt = '?';
+			mode_set = 1;
+		}
+		else if(opt == 'r')
+		{
+			reclaim = -1;
+			for(m = 0; m < NUM_RECLAIMERS; m++)
+			{
+				if(strcmp(optarg, reclaim_names[m]) == 0)
+					reclaim = m;
+			}
+			if(reclaim == -1)
+				opt = '?';
+		}
+		else if(opt == 'a')
+		{
+			allocator = -1;
+			for(m = 0; m < NUM_ALLOCATORS; m++)
+			{
+				if(strcmp(optarg, alloc_names[m]) == 0)
+					allocator = m;
+			}
+			if(allocator == -1)
+				opt = '?';
+		}
+		else if(opt == 'p')
+		{
+			policy = -1;
+			for(m = 0; m < NUM_POLICIES; m++)
+			{
+				if(strcmp(optarg, policy_names[m]) == 0)
+					policy = m;
+			}
+			if(policy == -1)
+				opt = '?';
+		}
+		else if(opt == 'k' && atoi(optarg) >= 1)
+			keys = atoi(optarg);
+		else if(opt == 'B' && atoi(optarg) >= 1)
+			batch = atoi(optarg);
+		else if(opt == 'H' && atoi(optarg) >= 1)
+			shards = atoi(optarg);
+		else if(opt == 'f')
+		{
+			image = optarg;
+			image_set = 1;
+		}
+		else if(opt == 'F')
+			durable = image_set = 1;
+		else if(opt == 'b' && atoi(optarg) >= 1)
+			bench_seconds = atoi(optarg);
+		else if(opt == 's' && atoi(optarg) >= 0)
+			threads[ROLE_SEARCH] = atoi(optarg);
+		else if(opt == 'i' && atoi(optarg) >= 0)
+			threads[ROLE_INSERT] = atoi(optarg);
+		else if(opt == 'd' && atoi(optarg) >= 0)
+			threads[ROLE_DELETE] = atoi(optarg);
+		else if(opt == 'M')
+		{
+			if(sscanf(optarg, "%d/%d/%d", &mix[ROLE_SEARCH], &mix[ROLE_INSERT], &mix[ROLE_DELETE]) != 3 || mix[ROLE_SEARCH] < 0 ||
+				mix[ROLE_INSERT] < 0 || mix[ROLE_DELETE] < 0 || mix[ROLE_SEARCH] + mix[ROLE_INSERT] + mix[ROLE_DELETE] != 100)
+				opt = '?';
+			if(mixed == 0)
+				mixed = BENCH_SEARCHERS + BENCH_INSERTERS + BENCH_DELETERS;
+		}
+		else if(opt == 't' && atoi(optarg) >= 1)
+			mixed = atoi(optarg);
+		else if(opt == 'P' && atoi(optarg) >= 0)
+			preload = atoi(optarg);
+		else if(opt == 'z')
+			stall = 1;
+		else if(opt == 'S' && atoi(optarg) >= 1)
+			sweep_threads = atoi(optarg);
+		else
+			opt = '?';
+
+		if(opt != '?' && batch > 0 && mode_set && !batches(mode))
+		{
+			printf("Batches (-B) need lightswitch or unrolled mode\n");
+			exit(1);
+		}
+		if(opt == '?')
+		{
+			printf("USAGE: main [-m lightswitch|rcu|coupling|unrolled|skiplist|snapshot|sharded|mapped|optimistic] [-r epoch|hazard] [-a malloc|pool] [-p reader|fair|deleter] [-k KEYS] [-B BATCH] [-H SHARDS] [-f FILE] [-F] [-b SECONDS [-s SEARCHERS] [-i INSERTERS] [-d DELETERS] [-M S/I/D [-t THREADS]] [-P PRELOAD] [-z | -S MAX_THREADS]]\n");
+			exit(1);
+		}
+	}
+	if(image_set && mode != MODE_MAPPED)
+	{
+		printf("Image files (-f, -F) need mapped mode\n");
+		exit(1);
+	}
+	if(mixed > 0 && mix[ROLE_SEARCH] + mix[ROLE_INSERT] + mix[ROLE_DELETE] == 0)
+	{
+		printf("Mixed threads (-t) need an operation mix (-M)\n");
+		exit(1);
+	}
+	if(mixed > 0)
+	{
+		//Every benchmark thread draws its operations from the mix
+		int role; for(role = 0; role < NUM_ROLES; role++)
+			threads[role] = 0;
+	}
+
 	unsigned int eax;
     unsigned int ebx;
     unsigned int ecx;
@@ -110,60 +412,83 @@ int main()
     }
 
     //Run main program code
-    driver();
+    if(sweep_threads > 0 && bench_seconds == 0)
+        bench_seconds = 1;
+    driver(mode_set ? mode : -1, reclaim, allocator, policy, keys, batch, shards, image, durable, bench_seconds, threads, mix, mixed, preload, stall, sweep_threads);
 
     return 0;
 }
 
 /*************************************************
  * Function: Runs the main program code
- * Description: Sets up the semaphores and the threads for execution
- * Params: none
+ * Description: Sets up the semaphores, the list and the threads for execution. In benchmark mode runs the threads without sleeps for a fixed time instead.
+ * Params: list mode (-1 for the default, or every mode when sweeping), reclaimer for rcu mode, node allocator, deleter policy, range of values, batch size (0 for single values), lists in sharded mode,
+ *         image file in mapped mode, 1 to msync every change to it, benchmark length in seconds (0 to run the demo forever),
+ *         benchmark threads of each role, percent of each role in the operation mix, benchmark threads that follow the mix, values to preload before a benchmark,
+ *         1 to have one benchmark searcher stall for the whole run,
+ *         most threads for a sweep over thread counts and modes (0 for a single benchmark run)
  * Returns: none
  * Pre-conditions: bit is set so prng knows what random number generator to use 
  * Post-conditions: none
  * **********************************************/
-void driver()
+void driver(int mode, int reclaim, int allocator, int policy, int keys, int batch, int shards, const char* image, int durable, int bench_seconds, int* threads, int* mix, int mixed, int preload, int stall, int sweep_threads)
 {
 	//Initialize constructs for problem
-	Node* head = NULL;
+	List list;
+	Lock_list locked;
+	Unrolled_list unrolled;
+	Skip_list skip;
+	Versioned_list versions;
+	Mapped_list mapped;
+	mapped.base = NULL;
 
-	Lightswitch search_switch, insert_switch;
-	sem_t *insert_mutex, *no_search, *no_insert, *talk;
-
-	insert_mutex = (sem_t*)malloc(sizeof(sem_t));
-	no_search = (sem_t*)malloc(sizeof(sem_t));
-	no_insert = (sem_t*)malloc(sizeof(sem_t));
+	Exclusion ex;
+	sem_t *talk;
 	talk = (sem_t*)malloc(sizeof(sem_t));
 
-	search_switch.counter = 0;
-	insert_switch.counter = 0;
-
-	search_switch.mutex = (sem_t*)malloc(sizeof(sem_t));
-	insert_switch.mutex = (sem_t*)malloc(sizeof(sem_t));
-
 	//Initialize semaphores
-	sem_init(insert_mutex, 0, 1);
-	sem_init(no_search, 0, 1);
-	sem_init(no_insert, 0, 1);
-	sem_init(search_switch.mutex, 0, 1);
-	sem_init(insert_switch.mutex, 0, 1);
+	ex_init(&ex);
 	sem_init(talk, 0, 1);
 
+	Shard* shard_array = (Shard*)aligned_alloc(64, sizeof(Shard)*shards);
+	int i; for(i = 0; i < shards; i++)
+		ex_init(&shard_array[i].ex);
+
 	//Initialize arguments
-	Searcher_args s_arg; 
-	Inserter_args i_arg; 
-	Deleter_args d_arg;
-	s_arg.list = &head; s_arg.talk = talk; 
-	i_arg.list = &head; i_arg.talk = talk;
-	d_arg.list = &head; d_arg.talk = talk;
-	s_arg.search_switch = &search_switch;
-	s_arg.no_search = no_search;
-	i_arg.insert_switch = &insert_switch;
-	i_arg.insert_mutex = insert_mutex;
-	i_arg.no_insert = no_insert;
-	d_arg.no_search = no_search;
-	d_arg.no_insert = no_insert;
+	Args_t args;
+	args.list = &list;
+	args.locked = &locked;
+	args.unrolled = &unrolled;
+	args.skip = &skip;
+	args.versions = &versions;
+	args.shards = shard_array;
+	args.num_shards = shards;
+	args.mapped = &mapped;
+	args.image = image;
+	args.durable = durable;
+	args.ex = &ex;
+	args.talk = talk;
+	args.mode = mode == -1 ? MODE_LIGHTSWITCH : mode;
+	args.reclaim = reclaim;
+	args.allocator = allocator;
+	args.policy = policy;
+	args.keys = keys;
+	args.batch = batch;
+	for(i = 0; i < NUM_ROLES; i++)
+		args.mix[i] = mix[i];
+	args.preload = preload;
+
+	if(sweep_threads > 0 || bench_seconds > 0)
+	{
+		if(sweep_threads > 0)
+			sweep(&args, bench_seconds, threads, sweep_threads, mode);
+		else
+			bench(&args, bench_seconds, threads, mixed, stall);
+		free(shard_array);
+		free(talk);
+		return;
+	}
+	setup_list(&args);
 
 	//Initialize threads
 	pthread_t *searchers, *inserters, *deleters;
@@ -173,17 +498,548 @@ void driver()
 	int num_inserters = prng()%5 + 1;
 	int num_deleters = prng()%5 + 1;
 
-	printf("Searchers: %d\tInserters: %d\tDeleters: %d\nThread execution will begin in 5 seconds...\n", num_searchers, num_inserters, num_deleters);
+	printf("Mode: %s\tSearchers: %d\tInserters: %d\tDeleters: %d\n", mode_label(&args), num_searchers, num_inserters, num_deleters);
+	if(args.mode == MODE_MAPPED)
+		printf("Image: %s\tOpened with %d values in %.3f ms\n", image, mapped.recovered, mapped.open_ns / 1e6);
+	printf("Thread execution will begin in 5 seconds...\n");
 	sleep(5);
 
-	searchers = get_threads(num_searchers, searcher, &s_arg);
-	inserters = get_threads(num_inserters, inserter, &i_arg);
-	deleters = get_threads(num_deleters, deleter, &d_arg);
+	searchers = get_threads(num_searchers, searcher, &args);
+	inserters = get_threads(num_inserters, inserter, &args);
+	deleters = get_threads(num_deleters, deleter, &args);
 
 	pthread_join(searchers[0], NULL); //Have the parent thread wait forever
 	return;
 }
 
+/*************************************************
+ * Function: setup_list
+ * Description: Creates an empty list, a node pool if asked for and fresh reclaimers for the mode in the arguments
+ * Params: Shared arguments
+ * Returns: None
+ * Pre-conditions: mode and allocator are set
+ * Post-conditions: Threads may start using the list
+ * **********************************************/
+void setup_list(Args_t* args)
+{
+	list_init(args->list);
+	ll_init(args->locked);
+	ul_init(args->unrolled);
+	sl_init(args->skip);
+	vl_init(args->versions);
+	int i; for(i = 0; i < args->num_shards; i++)
+		list_init(&args->shards[i].list);
+	if(args->mode == MODE_MAPPED && mp_open(args->mapped, args->image, args->durable) != 0)
+	{
+		printf("Can not map %s: %s\n", args->image, strerror(errno));
+		exit(1);
+	}
+	args->pool = NULL;
+	if(pooled(args))
+		args->pool = pool_new(node_size(args));
+	if(args->mode == MODE_COUPLING)
+		args->epoch = epoch_new(ll_free_node);
+	else if(args->mode == MODE_SKIPLIST)
+		args->epoch = epoch_new(sl_free_node);
+	else
+		args->epoch = epoch_new(reclaim_node);
+	args->hazard = hazard_new(reclaim_node);
+}
+
+/*************************************************
+ * Function: teardown_list
+ * Description: Frees every node and the reclaimers
+ * Params: Shared arguments
+ * Returns: None
+ * Pre-conditions: No thread is using the list
+ * Post-conditions: setup_list has to be called before the list is used again
+ * **********************************************/
+void teardown_list(Args_t* args)
+{
+	int i;
+	ll_free(args->locked);
+	sl_free(args->skip);
+	vl_free(args->versions);
+	mp_close(args->mapped); //The image keeps the list for the next run
+	epoch_free(args->epoch);
+	hazard_free(args->hazard);
+	if(args->pool)
+	{
+		//Every pooled node lives in a slab, destroying the pool frees them all at once
+		list_init(args->list);
+		ul_init(args->unrolled);
+		for(i = 0; i < args->num_shards; i++)
+			list_init(&args->shards[i].list);
+		pool_destroy(args->pool);
+		return;
+	}
+	free_list(args->list);
+	ul_free(args->unrolled);
+	for(i = 0; i < args->num_shards; i++)
+		free_list(&args->shards[i].list);
+}
+
+/*************************************************
+ * Function: reclaim_node
+ * Description: Frees a list node retired in rcu mode (the reclaim function for both reclaimers)
+ * Params: Pool cache of the thread that retired the node or NULL if nodes come from malloc, node
+ * Returns: None
+ * Pre-conditions: No searcher can reach the node anymore
+ * Post-conditions: Node is back in the pool or freed
+ * **********************************************/
+void reclaim_node(void* ctx, void* ptr)
+{
+	node_free((Pool_cache*)ctx, (Node*)ptr);
+}
+
+/*************************************************
+ * Function: node_size
+ * Description: Size of one list node in the mode in the arguments
+ * Params: Shared arguments
+ * Returns: Bytes per node
+ * Pre-conditions: mode is set
+ * Post-conditions: None
+ * **********************************************/
+size_t node_size(Args_t* args)
+{
+	if(args->mode == MODE_COUPLING)
+		return sizeof(Lock_node);
+	if(args->mode == MODE_UNROLLED)
+		return sizeof(Unrolled_node);
+	if(args->mode == MODE_SKIPLIST)
+		return sizeof(Skip_node) + 2 * sizeof(Skip_node*); //Nodes have two levels on average
+	if(args->mode == MODE_SNAPSHOT)
+		return sizeof(Version_node);
+	if(args->mode == MODE_MAPPED)
+		return sizeof(Mapped_node);
+	return sizeof(Node);
+}
+
+/*************************************************
+ * Function: list_size
+ * Description: Number of values in the list of the mode in the arguments
+ * Params: Shared arguments
+ * Returns: List length
+ * Pre-conditions: Nobody is changing the list
+ * Post-conditions: None
+ * **********************************************/
+int list_size(Args_t* args)
+{
+	if(args->mode == MODE_COUPLING)
+		return args->locked->size;
+	if(args->mode == MODE_UNROLLED)
+		return args->unrolled->size;
+	if(args->mode == MODE_SKIPLIST)
+		return args->skip->size;
+	if(args->mode == MODE_SNAPSHOT)
+		return vl_length(args->versions);
+	if(args->mode == MODE_MAPPED)
+		return mp_size(args->mapped);
+	if(args->mode == MODE_SHARDED)
+	{
+		int size = 0, i;
+		for(i = 0; i < args->num_shards; i++)
+			size += args->shards[i].list.size;
+		return size;
+	}
+	return args->list->size;
+}
+
+/*************************************************
+ * Function: pooled
+ * Description: Tells whether nodes of the mode in the arguments come from the pool
+ * Params: Shared arguments
+ * Returns: 1 if a pool was asked for and the mode's nodes can come from it, 0 otherwise
+ * Pre-conditions: mode and allocator are set
+ * Post-conditions: None
+ * **********************************************/
+int pooled(Args_t* args)
+{
+	return args->allocator == ALLOC_POOL && (args->mode == MODE_LIGHTSWITCH || args->mode == MODE_RCU || args->mode == MODE_UNROLLED || args->mode == MODE_SHARDED ||
+		args->mode == MODE_OPTIMISTIC);
+}
+
+/*************************************************
+ * Function: batches
+ * Description: Tells whether a mode has batch inserts and deletes
+ * Params: list mode
+ * Returns: 1 for the modes that give inserters and deleters the list to themselves (lightswitch and unrolled), 0 otherwise
+ * Pre-conditions: None
+ * Post-conditions: None
+ * **********************************************/
+int batches(int mode)
+{
+	return mode == MODE_LIGHTSWITCH || mode == MODE_UNROLLED;
+}
+
+/*************************************************
+ * Function: mode_label
+ * Description: Names the mode in the arguments, with the reclaimer in rcu mode, the number of shards in sharded mode and the deleter policy unless it is the default
+ * Params: Shared arguments
+ * Returns: Label such as "rcu/hazard/fair+pool" or "sharded/8" (static string)
+ * Pre-conditions: mode and reclaim are set
+ * Post-conditions: None
+ * **********************************************/
+const char* mode_label(Args_t* args)
+{
+	static char label[64];
+	if(args->mode == MODE_RCU)
+		snprintf(label, sizeof(label), "%s/%s", mode_names[args->mode], reclaim_names[args->reclaim]);
+	else
+		snprintf(label, sizeof(label), "%s", mode_names[args->mode]);
+	if(args->mode == MODE_SHARDED)
+		snprintf(label, sizeof(label), "%s/%d", mode_names[args->mode], args->num_shards);
+	if(args->policy != POLICY_READER && (args->mode == MODE_LIGHTSWITCH || args->mode == MODE_RCU || args->mode == MODE_UNROLLED || args->mode == MODE_SHARDED || args->mode == MODE_MAPPED ||
+		args->mode == MODE_OPTIMISTIC))
+	{
+		strcat(label, "/");
+		strcat(label, policy_names[args->policy]);
+	}
+	if(pooled(args))
+		strcat(label, "+pool");
+	return label;
+}
+
+/*************************************************
+ * Function: preload_list
+ * Description: Inserts random values from the main thread until the list holds the preload size (or every value, for the set in skiplist mode)
+ * Params: Shared arguments
+ * Returns: None
+ * Pre-conditions: setup_list was called and no other thread is using the list
+ * Post-conditions: List holds min(preload, keys) values in skiplist mode and preload values otherwise
+ * **********************************************/
+void preload_list(Args_t* args)
+{
+	int target = args->preload;
+	if(args->mode == MODE_SKIPLIST && target > args->keys)
+		target = args->keys;
+	if(target == 0)
+		return;
+	Worker w;
+	worker_init(&w, args);
+	while(list_size(args) < target)
+	{
+		int val = rand_r(&w.seed)%args->keys;
+		begin_insert(&w, val);
+		int inserted = insert_value(&w, val);
+		end_insert(&w);
+		if(!inserted && args->mode == MODE_MAPPED)
+			break; //Image can not grow
+	}
+}
+
+/*************************************************
+ * Function: run_bench
+ * Description: Runs the given number of searchers, inserters, deleters and mixed threads flat out on a freshly preloaded list for a fixed time,
+ * sampling every millisecond how many unlinked nodes are waiting to be freed
+ * Params: shared arguments, run length in seconds, threads of each role, threads that pick every operation from the mix,
+ *         1 to have the first searcher stall in the middle of a search for the whole run, Bench_result to fill
+ * Returns: None
+ * Pre-conditions: Arguments are filled out and nothing else is using the list
+ * Post-conditions: Every benchmark thread has been joined and the list is freed
+ * **********************************************/
+void run_bench(Args_t* args, int seconds, int* threads, int mixed, int stall, Bench_result* result)
+{
+	int total = threads[ROLE_SEARCH] + threads[ROLE_INSERT] + threads[ROLE_DELETE] + mixed;
+	int stop = 0;
+	pthread_t* ids = (pthread_t*)malloc(sizeof(pthread_t)*total);
+	Bench_args* b_args = (Bench_args*)calloc(total, sizeof(Bench_args));
+	int role, i, t = 0;
+	setup_list(args);
+	preload_list(args);
+	for(role = ROLE_MIXED; role < NUM_ROLES; role++)
+	{
+		for(i = 0; i < (role == ROLE_MIXED ? mixed : threads[role]); i++, t++)
+		{
+			b_args[t].shared = args;
+			b_args[t].role = role;
+			b_args[t].stall = stall && role == ROLE_SEARCH && i == 0;
+			b_args[t].stop = &stop;
+			b_args[t].seed = prng();
+		}
+	}
+	for(t = 0; t < total; t++)
+		pthread_create(&ids[t], NULL, bench_thread, &b_args[t]);
+
+	long now;
+	struct timespec tick = { 0, 1000000 };
+	unsigned long long start = now_ns();
+	result->peak = 0;
+	while(now_ns() - start < (unsigned long long)seconds * 1000000000ULL)
+	{
+		nanosleep(&tick, NULL);
+		now = pending(args);
+		if(now > result->peak)
+			result->peak = now;
+	}
+	__atomic_store_n(&stop, 1, __ATOMIC_RELAXED);
+	for(t = 0; t < total; t++)
+		pthread_join(ids[t], NULL);
+	result->elapsed = (now_ns() - start) / 1e9;
+
+	for(role = 0; role < NUM_ROLES; role++)
+	{
+		unsigned long long ops = 0, values = 0;
+		Wait_stats waits = { NULL, 0, 0 }, latency = { NULL, 0, 0 };
+		for(t = 0; t < total; t++)
+		{
+			ops += b_args[t].ops[role];
+			values += b_args[t].values[role];
+			ws_merge(&waits, &b_args[t].waits[role]);
+			ws_merge(&latency, &b_args[t].latency[role]);
+			ws_free(&b_args[t].waits[role]);
+			ws_free(&b_args[t].latency[role]);
+		}
+		result->ops[role] = ops / result->elapsed;
+		result->values[role] = values / result->elapsed;
+		result->waits[role] = waits;
+		result->latency[role] = latency;
+	}
+	result->pending = pending(args);
+	result->freed = args->epoch->freed + args->hazard->freed;
+	result->size = list_size(args);
+	result->pool_bytes = args->pool ? pool_bytes(args->pool) : 0;
+
+	teardown_list(args);
+	free(ids);
+	free(b_args);
+}
+
+/*************************************************
+ * Function: report
+ * Description: Prints one row of percentiles of a role's samples and frees them
+ * Params: role name, Wait_stats pointer
+ * Returns: None
+ * Pre-conditions: Nobody is still adding samples
+ * Post-conditions: Samples are freed
+ * **********************************************/
+void report(const char* label, Wait_stats* ws)
+{
+	ws_sort(ws);
+	printf("%-8s %12d %10u %10u %10u %10u %10u\n", label, ws->count, ws_percentile(ws, 50), ws_percentile(ws, 90),
+		ws_percentile(ws, 99), ws_percentile(ws, 99.9), ws_percentile(ws, 100));
+	ws_free(ws);
+}
+
+/*************************************************
+ * Function: bench
+ * Description: Runs one benchmark and prints the operations per second of each role, how long each role waited to get at the list and how long
+ * its operations took from start to end, the list length at the end and how many unlinked nodes were waiting to be freed
+ * Params: shared arguments, run length in seconds, threads of each role, threads that pick every operation from the mix,
+ *         1 to have the first searcher stall in the middle of a search for the whole run
+ * Returns: None
+ * Pre-conditions: Arguments are filled out and nothing else is using the list
+ * Post-conditions: None
+ * **********************************************/
+void bench(Args_t* args, int seconds, int* threads, int mixed, int stall)
+{
+	Bench_result result;
+	run_bench(args, seconds, threads, mixed, stall, &result);
+
+	if(mixed > 0)
+		printf("Mode: %s\tThreads: %d\tMix: %d/%d/%d\tPreload: %d\t%.2f s\n", mode_label(args), mixed,
+			args->mix[ROLE_SEARCH], args->mix[ROLE_INSERT], args->mix[ROLE_DELETE], args->preload, result.elapsed);
+	else
+		printf("Mode: %s\tSearchers: %d\tInserters: %d\tDeleters: %d\tPreload: %d\t%s%.2f s\n", mode_label(args),
+			threads[ROLE_SEARCH], threads[ROLE_INSERT], threads[ROLE_DELETE], args->preload, stall ? "Stalled searcher\t" : "", result.elapsed);
+	if(args->mode == MODE_MAPPED)
+		printf("Image: %s%s\tOpened with %d values in %.3f ms\n", args->image, args->durable ? " (durable)" : "",
+			args->mapped->recovered, args->mapped->open_ns / 1e6);
+	printf("%-8s %8s %14s %14s\n", "role", "threads", "ops/s", "values/s");
+	int role; for(role = 0; role < NUM_ROLES; role++)
+		printf("%-8s %8d %14.0f %14.0f\n", role_names[role], mixed > 0 ? mixed : threads[role], result.ops[role], result.values[role]);
+	printf("%-8s %12s %10s %10s %10s %10s %10s\n", "wait", "samples", "p50_ns", "p90_ns", "p99_ns", "p999_ns", "max_ns");
+	for(role = 0; role < NUM_ROLES; role++)
+		report(role_names[role], &result.waits[role]);
+	printf("%-8s %12s %10s %10s %10s %10s %10s\n", "latency", "samples", "p50_ns", "p90_ns", "p99_ns", "p999_ns", "max_ns");
+	for(role = 0; role < NUM_ROLES; role++)
+		report(role_names[role], &result.latency[role]);
+	printf("List values: %d\tRetired not freed: peak %ld (%.1f KiB), end %ld\tFreed by reclaimer: %llu\n", result.size,
+		result.peak, result.peak * node_size(args) / 1024.0, result.pending, result.freed);
+	if(args->pool)
+		printf("Pool slabs: %.1f MiB\n", result.pool_bytes / 1048576.0);
+}
+
+/*************************************************
+ * Function: sweep
+ * Description: Benchmarks every mode (or just one) at 1, 2, 4, ... up to max_threads threads and prints one row per run.
+ * The threads of a run are split over the roles in the ratio of the per role counts, or all follow the mix if there is one.
+ * Params: shared arguments, run length in seconds, per role ratio, most threads, mode to run or -1 for every mode
+ * Returns: None
+ * Pre-conditions: Arguments are filled out and nothing else is using the list
+ * Post-conditions: None
+ * **********************************************/
+void sweep(Args_t* args, int seconds, int* ratio, int max_threads, int only)
+{
+	Bench_result result;
+	int threads[NUM_ROLES];
+	int n, mode, role, i;
+	int mixing = args->mix[ROLE_SEARCH] + args->mix[ROLE_INSERT] + args->mix[ROLE_DELETE] > 0;
+	printf("%8s %-22s %11s %12s %12s %12s %12s %10s\n", "threads", "mode", "s/i/d", "search/s", "insert/s", "delete/s", "total/s", "nodes");
+	for(n = 1; n <= max_threads; n = (n * 2 > max_threads && n < max_threads) ? max_threads : n * 2)
+	{
+		//Hand out threads one at a time to the role furthest below its share
+		for(role = 0; role < NUM_ROLES; role++)
+			threads[role] = 0;
+		for(i = 0; i < n; i++)
+		{
+			int pick = -1;
+			for(role = 0; role < NUM_ROLES; role++)
+			{
+				if(ratio[role] > 0 && (pick == -1 || threads[role] * ratio[pick] < threads[pick] * ratio[role]))
+					pick = role;
+			}
+			if(pick == -1)
+				break;
+			threads[pick]++;
+		}
+
+		for(mode = 0; mode < NUM_MODES; mode++)
+		{
+			if((only != -1 && mode != only) || (args->batch > 0 && !batches(mode)) || (only == -1 && mode == MODE_MAPPED))
+				continue; //Mapped mode leaves an image behind, so it only runs when asked for
+			args->mode = mode;
+			run_bench(args, seconds, threads, mixing ? n : 0, 0, &result);
+			for(role = 0; role < NUM_ROLES; role++)
+			{
+				ws_free(&result.waits[role]);
+				ws_free(&result.latency[role]);
+			}
+			char split[32];
+			if(mixing)
+				snprintf(split, sizeof(split), "%d%%/%d%%/%d%%", args->mix[ROLE_SEARCH], args->mix[ROLE_INSERT], args->mix[ROLE_DELETE]);
+			else
+				snprintf(split, sizeof(split), "%d/%d/%d", threads[ROLE_SEARCH], threads[ROLE_INSERT], threads[ROLE_DELETE]);
+			printf("%8d %-22s %11s %12.0f %12.0f %12.0f %12.0f %10d\n", n, mode_label(args), split, result.ops[ROLE_SEARCH],
+				result.ops[ROLE_INSERT], result.ops[ROLE_DELETE], result.ops[ROLE_SEARCH] + result.ops[ROLE_INSERT] + result.ops[ROLE_DELETE], result.size);
+			fflush(stdout);
+		}
+	}
+}
+
+/*************************************************
+ * Function: bench_thread
+ * Description: Thread function for benchmark threads. Repeats the operation of its role (or one drawn from the mix for every operation)
+ * with no sleeps and no prints until the run is over.
+ * Params: Bench_args pointer structure
+ * Returns: None
+ * Pre-conditions: Arguments structure is properly filled out
+ * Post-conditions: ops holds the number of operations done per role, values the nodes they touched, waits how long each one waited
+ * to get at the list and latency how long each one took
+ * **********************************************/
+void* bench_thread(void* args)
+{
+	Bench_args* b_arg = (Bench_args*)args;
+	Worker w;
+	worker_init(&w, b_arg->shared);
+	if(b_arg->stall)
+	{
+		stall_search(&w, b_arg->stop);
+		return NULL;
+	}
+
+	int batch = w.args->batch;
+	int* values = batch > 0 ? (int*)malloc(sizeof(int)*batch) : NULL;
+	unsigned long long arrived;
+	int i, role;
+	while(!__atomic_load_n(b_arg->stop, __ATOMIC_RELAXED))
+	{
+		role = b_arg->role;
+		if(role == ROLE_MIXED)
+		{
+			int roll = rand_r(&b_arg->seed)%100;
+			for(role = 0; role < NUM_ROLES - 1 && roll >= w.args->mix[role]; role++)
+				roll -= w.args->mix[role];
+		}
+		arrived = now_ns();
+		if(role == ROLE_SEARCH)
+		{
+			int val = rand_r(&b_arg->seed)%w.args->keys;
+			begin_search(&w);
+			ws_add(&b_arg->waits[role], now_ns() - arrived);
+			b_arg->values[role] += search(&w, val, NULL);
+			end_search(&w);
+		}
+		else if(role == ROLE_INSERT && batch > 0)
+		{
+			for(i = 0; i < batch; i++)
+				values[i] = rand_r(&b_arg->seed)%w.args->keys;
+			begin_insert(&w, values[0]);
+			ws_add(&b_arg->waits[role], now_ns() - arrived);
+			b_arg->values[role] += insert_values(&w, values, batch);
+			end_insert(&w);
+		}
+		else if(role == ROLE_INSERT)
+		{
+			int val = rand_r(&b_arg->seed)%w.args->keys;
+			begin_insert(&w, val);
+			ws_add(&b_arg->waits[role], now_ns() - arrived);
+			b_arg->values[role] += insert_value(&w, val);
+			end_insert(&w);
+		}
+		else if(batch > 0)
+		{
+			int lo = rand_r(&b_arg->seed)%w.args->keys;
+			begin_delete(&w, lo);
+			ws_add(&b_arg->waits[role], now_ns() - arrived);
+			b_arg->values[role] += delete_range(&w, lo, lo + batch);
+			end_delete(&w);
+		}
+		else
+		{
+			int val = rand_r(&b_arg->seed)%w.args->keys;
+			begin_delete(&w, val);
+			ws_add(&b_arg->waits[role], now_ns() - arrived);
+			b_arg->values[role] += delete_value(&w, val);
+			end_delete(&w);
+		}
+		ws_add(&b_arg->latency[role], now_ns() - arrived);
+		b_arg->ops[role]++;
+	}
+	free(values);
+	return NULL;
+}
+
+/*************************************************
+ * Function: stall_search
+ * Description: Starts a search and stops on the first node until the run is over, like a reader that got descheduled mid traversal
+ * Params: Worker pointer, flag set when the run is over
+ * Returns: None
+ * Pre-conditions: None
+ * Post-conditions: Search is finished
+ * **********************************************/
+void stall_search(Worker* w, int* stop)
+{
+	struct timespec tick = { 0, 1000000 };
+	begin_search(w);
+	if(w->args->mode == MODE_RCU && w->args->reclaim == RECLAIM_HAZARD)
+		hazard_protect(w->hazard, 0, (void**)&w->args->list->head);
+	while(!__atomic_load_n(stop, __ATOMIC_RELAXED))
+		nanosleep(&tick, NULL);
+	if(w->args->mode == MODE_RCU && w->args->reclaim == RECLAIM_HAZARD)
+		hazard_clear(w->hazard);
+	end_search(w);
+}
+
+/*************************************************
+ * Function: pending
+ * Description: Counts unlinked nodes the reclaimer has not freed yet
+ * Params: Shared arguments
+ * Returns: Number of retired nodes waiting, 0 in lightswitch mode
+ * Pre-conditions: None
+ * Post-conditions: None
+ * **********************************************/
+long pending(Args_t* args)
+{
+	if(args->mode == MODE_LIGHTSWITCH)
+		return 0;
+	if(args->mode == MODE_RCU && args->reclaim == RECLAIM_HAZARD)
+		return hazard_pending(args->hazard);
+	if(args->mode == MODE_SNAPSHOT)
+		return vl_pending(args->versions); //Kept alive by snapshots of older versions
+	return epoch_pending(args->epoch);
+}
+
 /*************************************************
  * Function: get_threads
  * Description: Creates and returns a certain number of threads given the function and arguments to use
@@ -203,229 +1059,676 @@ pthread_t* get_threads(int num_threads, void* function, void* args)
 }
 
 /*************************************************
- * Function: searcher
- * Description: Thread function for searcher threads. It will print each item from the linked list (Basically a search of the whole list) when there are no deleters in use
- * Params: Searcher_args pointer structure.
+ * Function: worker_init
+ * Description: Sets up the per thread state of a searcher, inserter or deleter
+ * Params: Worker pointer, shared arguments
  * Returns: None
- * Pre-conditions: Arguments structure is properly filled out
- * Post-conditions: None
+ * Pre-conditions: Called from the thread that will use the worker
+ * Post-conditions: Worker holds its own reclamation records and pool cache
  * **********************************************/
-void* searcher(void* args)
+void worker_init(Worker* w, Args_t* args)
 {
-	Searcher_args* s_arg = (Searcher_args*)(args); //Get arguments into proper structure for usage
-	int id = pthread_self(); //Get id for informative prints
-	while(1)
+	w->args = args;
+	w->cache = args->pool ? pool_register(args->pool) : NULL;
+	w->seed = prng();
+	w->epoch = epoch_register(args->epoch, w->cache);
+	w->hazard = hazard_register(args->hazard, w->cache);
+	w->id = pthread_self();
+	if(w->epoch == NULL || w->hazard == NULL || (args->pool && w->cache == NULL))
 	{
-		//Enforce semaphore for STDOUT usage
-		sem_wait(s_arg->talk);
-		printf("[SEARCH-WAIT] Thread 0x%x is checking for active delete threads.\n", id);
-		sem_post(s_arg->talk);
-		ls_lock(s_arg->search_switch, s_arg->no_search); //Flip the lightswitch for searchers if first thread
+		printf("More than %d threads\n", EPOCH_MAX_THREADS);
+		exit(1);
+	}
+}
 
-		sem_wait(s_arg->talk);
-		printf("[SEARCH-ACTION] Thread 0x%x is searching the list.\nList: ", id);
-		show_list(*(s_arg->list)); //Search through the linked list
-		sem_post(s_arg->talk);
+/*************************************************
+ * Function: ex_init
+ * Description: Sets up the semaphores of the protocol for one list
+ * Params: Exclusion pointer
+ * Returns: None
+ * Pre-conditions: None
+ * Post-conditions: Nobody holds the list
+ * **********************************************/
+void ex_init(Exclusion* ex)
+{
+	ex->search_switch.counter = 0;
+	ex->insert_switch.counter = 0;
+	ex->delete_switch.counter = 0;
+	ex->search_switch.mutex = &ex->switch_mutex[0];
+	ex->insert_switch.mutex = &ex->switch_mutex[1];
+	ex->delete_switch.mutex = &ex->switch_mutex[2];
+	int i; for(i = 0; i < 3; i++)
+		sem_init(&ex->switch_mutex[i], 0, 1);
+	sem_init(&ex->insert_mutex, 0, 1);
+	sem_init(&ex->no_search, 0, 1);
+	sem_init(&ex->no_insert, 0, 1);
+	sem_init(&ex->turnstile, 0, 1);
+}
 
-		sleep(prng()%3+1);
+/*************************************************
+ * Function: enter_turnstile
+ * Description: Lets a searcher or inserter past the turnstile before it flips its lightswitch. Fair: waits behind a deleter that is already waiting.
+ * Deleter: waits until no deleter is waiting or deleting, and keeps the turnstile until leave_turnstile so deleters arriving meanwhile are not shut out.
+ * Params: Exclusion pointer, deleter policy
+ * Returns: None
+ * Pre-conditions: None
+ * Post-conditions: leave_turnstile must be called once the lightswitch is flipped
+ * **********************************************/
+void enter_turnstile(Exclusion* ex, int policy)
+{
+	if(policy == POLICY_READER)
+		return;
+	sem_wait(&ex->turnstile);
+	if(policy == POLICY_FAIR)
+		sem_post(&ex->turnstile);
+}
 
-		ls_unlock(s_arg->search_switch, s_arg->no_search); //Flip the lightswitch for searchers if last thread
-		sleep(prng()%10+1); //Sleep for awhile before next attempt to search
-	}
-	return;
+/*************************************************
+ * Function: leave_turnstile
+ * Description: Lets the next thread at the turnstile (deleter policy)
+ * Params: Exclusion pointer, deleter policy
+ * Returns: None
+ * Pre-conditions: enter_turnstile was called and the caller's lightswitch is flipped
+ * Post-conditions: None
+ * **********************************************/
+void leave_turnstile(Exclusion* ex, int policy)
+{
+	if(policy == POLICY_DELETER)
+		sem_post(&ex->turnstile);
 }
 
 /*************************************************
- * Function: inserter
- * Description: Thread function for inserter threads. It will insert an item onto the end of the linked list when there are no other inserters or deleters in use
- * Params: Inserter_args pointer structure
+ * Function: search_lock
+ * Description: Waits until the list may be searched: the first searcher in locks out deleters, after the turnstile of the fair and deleter policies
+ * Params: Exclusion pointer, deleter policy
  * Returns: None
- * Pre-conditions: Arguments structure is properly filled out
- * Post-conditions: 
+ * Pre-conditions: None
+ * Post-conditions: No deleter uses the list until search_unlock
  * **********************************************/
-void* inserter(void* args)
+void search_lock(Exclusion* ex, int policy)
 {
-	Inserter_args* i_arg = (Inserter_args*)(args);
-	int val;
-	int id = pthread_self();
-	while(1)
-	{
-		val = prng()%101; //Random value to add to the list
-		sem_wait(i_arg->talk);
-		printf("[INSERT-WAIT] Thread 0x%x is checking for active insert and delete threads.\n", id);
-		sem_post(i_arg->talk);
-		ls_lock(i_arg->insert_switch, i_arg->no_insert); //Flip the lightswitch for inserters if first thread
-		sem_wait(i_arg->insert_mutex);
+	enter_turnstile(ex, policy);
+	ls_lock(&ex->search_switch, &ex->no_search); //Flip the lightswitch for searchers if first thread
+	leave_turnstile(ex, policy);
+}
 
-		insert(i_arg->list, val); //Insert into the list
-		sem_wait(i_arg->talk);
-		printf("[INSERT-ACTION] Thread: 0x%x inserted %d into the list.\n", id, val);
-		sem_post(i_arg->talk);
+/*************************************************
+ * Function: search_unlock
+ * Description: Ends a search started with search_lock
+ * Params: Exclusion pointer
+ * Returns: None
+ * Pre-conditions: search_lock was called
+ * Post-conditions: None
+ * **********************************************/
+void search_unlock(Exclusion* ex)
+{
+	ls_unlock(&ex->search_switch, &ex->no_search); //Flip the lightswitch for searchers if last thread
+}
 
-		sleep(prng()%3+1); //Sleep between 1 and 3 seconds for insertion time
+/*************************************************
+ * Function: insert_lock
+ * Description: Waits until no deleter and no other inserter is using the list
+ * Params: Exclusion pointer, deleter policy
+ * Returns: None
+ * Pre-conditions: None
+ * Post-conditions: Caller is the only thread changing the list until insert_unlock
+ * **********************************************/
+void insert_lock(Exclusion* ex, int policy)
+{
+	enter_turnstile(ex, policy);
+	ls_lock(&ex->insert_switch, &ex->no_insert); //Flip the lightswitch for inserters if first thread
+	leave_turnstile(ex, policy);
+	sem_wait(&ex->insert_mutex);
+}
 
-		sem_post(i_arg->insert_mutex);
-		ls_unlock(i_arg->insert_switch, i_arg->no_insert); //Flip the lightswitch for inserters if last thread
-		sleep(prng()%10+1); //Sleep for awhile before next attempt to insert
+/*************************************************
+ * Function: insert_unlock
+ * Description: Ends an insert started with insert_lock
+ * Params: Exclusion pointer
+ * Returns: None
+ * Pre-conditions: insert_lock was called
+ * Post-conditions: None
+ * **********************************************/
+void insert_unlock(Exclusion* ex)
+{
+	sem_post(&ex->insert_mutex);
+	ls_unlock(&ex->insert_switch, &ex->no_insert); //Flip the lightswitch for inserters if last thread
+}
 
-	}
-	return;
+/*************************************************
+ * Function: delete_lock
+ * Description: Waits until no inserter or deleter, and unless told otherwise no searcher, is using the list. Fair and deleter policies: holds the turnstile
+ * while waiting so searchers and inserters arriving later queue up behind.
+ * Params: Exclusion pointer, deleter policy, 1 to wait for searchers too (0 when they can not be hurt by deletes)
+ * Returns: None
+ * Pre-conditions: None
+ * Post-conditions: Caller has the list to itself (apart from searchers if told so) until delete_unlock
+ * **********************************************/
+void delete_lock(Exclusion* ex, int policy, int searchers)
+{
+	if(policy == POLICY_DELETER)
+		ls_lock(&ex->delete_switch, &ex->turnstile); //First deleter shuts out searchers and inserters that have not flipped their lightswitch yet
+	else if(policy == POLICY_FAIR)
+		sem_wait(&ex->turnstile); //Nobody arriving after us gets past until we are in
+	if(searchers)
+		sem_wait(&ex->no_search); //Any searchers?
+	sem_wait(&ex->no_insert); //Any inserters or deleters?
+	if(policy == POLICY_FAIR)
+		sem_post(&ex->turnstile);
 }
 
 /*************************************************
- * Function: deleter
- * Description: Thread function for deleter threads. Deletes an item from the end of the list if there are no searchers, deleters or inserter threads currently active (or queued to wait before)
- * Params: Deleter_args pointer structure
+ * Function: delete_unlock
+ * Description: Ends a delete started with delete_lock
+ * Params: Exclusion pointer, deleter policy, searchers flag given to delete_lock
  * Returns: None
- * Pre-conditions: Arguments is properly filled out
+ * Pre-conditions: delete_lock was called
  * Post-conditions: None
  * **********************************************/
-void* deleter(void* args)
+void delete_unlock(Exclusion* ex, int policy, int searchers)
 {
-	Deleter_args* d_arg = (Deleter_args*)(args);
-	int id = pthread_self();
-	while(1)
-	{
-		sem_wait(d_arg->talk);
-		printf("[DELETE-WAIT] Thread 0x%x is checking for active search, insert and delete threads.\n", id);
-		sem_post(d_arg->talk);
-		sem_wait(d_arg->no_search); //Any searchers?
-		sem_wait(d_arg->no_insert); //Any deleters?
+	sem_post(&ex->no_insert);
+	if(searchers)
+		sem_post(&ex->no_search);
+	if(policy == POLICY_DELETER)
+		ls_unlock(&ex->delete_switch, &ex->turnstile); //Last deleter out opens the turnstile
+}
 
-		delete_end(d_arg->list); //Delete item from end of the list
-		sem_wait(d_arg->talk);
-		printf("[DELETE-ACTION] Thread 0x%x deleted end of list.\n", id);
-		sem_post(d_arg->talk);
-		sleep(prng()%3+1); //Sleep between 1 and 3 seconds during deletion
+/*************************************************
+ * Function: shard_of
+ * Description: Picks the shard a value belongs to (multiplicative hash, so neighbouring values spread out)
+ * Params: Shared arguments, value
+ * Returns: Shard pointer
+ * Pre-conditions: Sharded mode
+ * Post-conditions: None
+ * **********************************************/
+Shard* shard_of(Args_t* args, int value)
+{
+	return &args->shards[((unsigned int)value * 2654435761u) % args->num_shards];
+}
 
-		sem_post(d_arg->no_insert);
-		sem_post(d_arg->no_search);
-		sleep(prng()%10+1); //Sleep between 1 and 10 seconds before trying to delete again
+/*************************************************
+ * Function: shard_scan
+ * Description: Walks every shard, each under its own searcher lightswitch so only that shard is held at a time. Starts at a random shard
+ * so concurrent scans spread over the shards instead of queueing up behind each other.
+ * Params: Worker pointer, stream to print the values to or NULL
+ * Returns: Number of nodes visited
+ * Pre-conditions: Sharded mode
+ * Post-conditions: No shard is held
+ * **********************************************/
+int shard_scan(Worker* w, FILE* out)
+{
+	int visited = 0, start = rand_r(&w->seed) % w->args->num_shards, i;
+	for(i = 0; i < w->args->num_shards; i++)
+	{
+		Shard* shard = &w->args->shards[(start + i) % w->args->num_shards];
+		search_lock(&shard->ex, w->args->policy);
+		visited += show_list(&shard->list, out);
+		search_unlock(&shard->ex);
 	}
-	return;
+	return visited;
+}
+
+/*************************************************
+ * Function: begin_search
+ * Description: Waits until the list may be searched. Lightswitch: first searcher in locks out deleters, after the turnstile of the deleter policy.
+ * Rcu, skiplist and optimistic: enters a read section, never waits. Snapshot: takes the current version, never waits for writers.
+ * Coupling: nothing, the search locks nodes as it goes. Sharded: nothing, the search holds one shard at a time.
+ * Params: Worker pointer
+ * Returns: None
+ * Pre-conditions: None
+ * Post-conditions: Caller may search until end_search
+ * **********************************************/
+void begin_search(Worker* w)
+{
+	if(w->args->mode == MODE_COUPLING || w->args->mode == MODE_SHARDED || (w->args->mode == MODE_RCU && w->args->reclaim == RECLAIM_HAZARD))
+		return; //Nodes or shards are locked or published on the way, nothing to enter
+	else if(w->args->mode == MODE_RCU || w->args->mode == MODE_SKIPLIST || w->args->mode == MODE_OPTIMISTIC)
+		epoch_enter(w->args->epoch, w->epoch);
+	else if(w->args->mode == MODE_SNAPSHOT)
+		w->snapshot = vl_snapshot(w->args->versions);
+	else
+		search_lock(w->args->ex, w->args->policy);
+}
+
+/*************************************************
+ * Function: end_search
+ * Description: Ends a search started with begin_search
+ * Params: Worker pointer
+ * Returns: None
+ * Pre-conditions: begin_search was called
+ * Post-conditions: None
+ * **********************************************/
+void end_search(Worker* w)
+{
+	if(w->args->mode == MODE_COUPLING || w->args->mode == MODE_SHARDED || (w->args->mode == MODE_RCU && w->args->reclaim == RECLAIM_HAZARD))
+		return;
+	else if(w->args->mode == MODE_RCU || w->args->mode == MODE_SKIPLIST || w->args->mode == MODE_OPTIMISTIC)
+		epoch_exit(w->epoch);
+	else if(w->args->mode == MODE_SNAPSHOT)
+		vl_release(w->args->versions, w->snapshot); //Frees whatever only this snapshot still held
+	else
+		search_unlock(w->args->ex);
+}
+
+/*************************************************
+ * Function: search
+ * Description: Walks the whole list (snapshot: the version taken in begin_search, newest value first; sharded: one shard after the other).
+ * Skiplist: looks the value up instead.
+ * Params: Worker pointer, value to look up (skiplist mode only), stream to print the values to or NULL
+ * Returns: Number of nodes visited, or in skiplist mode 1 if the value is in the set and 0 otherwise
+ * Pre-conditions: Between begin_search and end_search
+ * Post-conditions: None
+ * **********************************************/
+int search(Worker* w, int value, FILE* out)
+{
+	if(w->args->mode == MODE_SKIPLIST)
+		return sl_contains(w->args->skip, value);
+	if(w->args->mode == MODE_SNAPSHOT)
+		return vl_walk(w->snapshot, out);
+	if(w->args->mode == MODE_SHARDED)
+		return shard_scan(w, out);
+	if(w->args->mode == MODE_COUPLING)
+		return ll_walk(w->args->locked, out);
+	if(w->args->mode == MODE_UNROLLED)
+		return ul_walk(w->args->unrolled, out);
+	if(w->args->mode == MODE_MAPPED)
+		return mp_walk(w->args->mapped, out);
+	if(w->args->mode == MODE_RCU && w->args->reclaim == RECLAIM_HAZARD)
+		return hazard_walk(w->args->list, w->hazard, out);
+	if(w->args->mode == MODE_RCU)
+		return rcu_walk(w->args->list, out);
+	if(w->args->mode == MODE_OPTIMISTIC)
+		return olc_walk(w->args->list, out);
+	return show_list(w->args->list, out);
 }
 
 /*************************************************
- * Function: show_list
- * Description: Prints out the contents of a linked list. Used by the searcher thread to simulate searching (Reads).
- * Params: Linked list node pointer (First call should be the head if you want to print out entire list)
+ * Function: begin_insert
+ * Description: Waits until no deleter and no other inserter is using the list. Coupling: enters an epoch read section so the tail it locks can not be freed under it.
+ * Skiplist: enters an epoch read section, the insert only locks the nodes it links to. Snapshot: nothing, the list serializes writers itself.
+ * Sharded: only waits for the shard the value belongs to.
+ * Params: Worker pointer, value to insert
  * Returns: None
- * Pre-conditions: None 
- * Post-conditions: Linked list is printed out or if list is empty a newline is printed
+ * Pre-conditions: None
+ * Post-conditions: Caller may insert until end_insert
  * **********************************************/
-void show_list(Node* node)
+void begin_insert(Worker* w, int value)
 {
-	if(node != NULL)
+	if(w->args->mode == MODE_SNAPSHOT)
+		return;
+	if(w->args->mode == MODE_COUPLING || w->args->mode == MODE_SKIPLIST)
 	{
-		printf("%d, ", node->value);
-		show_list(node->next);
+		epoch_enter(w->args->epoch, w->epoch);
 		return;
 	}
-	printf("\n");
+	if(w->args->mode == MODE_SHARDED)
+	{
+		w->shard = shard_of(w->args, value);
+		insert_lock(&w->shard->ex, w->args->policy);
+		return;
+	}
+	insert_lock(w->args->ex, w->args->policy);
 }
 
 /*************************************************
- * Function: insert
- * Description: Inserts a node onto the end of a singly linked list. Creates a head if the list is empty.
- * Params: Pointer to Linked List node pointer (This is so that if the list is empty, a head can be created)
- *		   Integer value to be inserted as new node.
+ * Function: end_insert
+ * Description: Ends an insert started with begin_insert
+ * Params: Worker pointer
  * Returns: None
- * Pre-conditions: None 
- * Post-conditions: New node is allocated memory and added to the linked list
+ * Pre-conditions: begin_insert was called
+ * Post-conditions: None
  * **********************************************/
-void insert(Node** node, int value)
+void end_insert(Worker* w)
 {
-	if(*node == NULL)
+	if(w->args->mode == MODE_SNAPSHOT)
+		return;
+	if(w->args->mode == MODE_COUPLING || w->args->mode == MODE_SKIPLIST)
 	{
-		*node = (Node*)malloc(sizeof(Node));
-		(*node)->value = value;
-		(*node)->next = NULL;
+		epoch_exit(w->epoch);
 		return;
 	}
-	insert(&(*node)->next, value);
+	insert_unlock(w->args->mode == MODE_SHARDED ? &w->shard->ex : w->args->ex);
 }
 
 /*************************************************
- * Function: delete
- * Description: Deletes the node in the linked list corresponding to the value passed in. Deallocates node deleted.
- * Params: Pointer to Linked List node pointer (This is needed if the head will be deleted)
- *         Integer value corresponding to the node you want deleted from the list.
+ * Function: insert_value
+ * Description: Appends a value to the list. Skiplist: adds the value to the set.
+ * Params: Worker pointer, value
+ * Returns: 1 if the value was inserted, 0 if the set already held it (or the image of mapped mode can not grow)
+ * Pre-conditions: Between begin_insert and end_insert
+ * Post-conditions: Value is in the list
+ * **********************************************/
+int insert_value(Worker* w, int value)
+{
+	if(w->args->mode == MODE_SKIPLIST)
+		return sl_add(w->args->skip, value, &w->seed);
+	if(w->args->mode == MODE_MAPPED)
+		return mp_append(w->args->mapped, value);
+	if(w->args->mode == MODE_SNAPSHOT)
+		vl_append(w->args->versions, value);
+	else if(w->args->mode == MODE_SHARDED)
+		insert(&w->shard->list, value, w->cache);
+	else if(w->args->mode == MODE_COUPLING)
+		ll_append(w->args->locked, value);
+	else if(w->args->mode == MODE_UNROLLED)
+		ul_append(w->args->unrolled, value, w->cache);
+	else if(w->args->mode == MODE_RCU)
+		rcu_insert(w->args->list, value, w->cache);
+	else if(w->args->mode == MODE_OPTIMISTIC)
+		olc_insert(w->args->list, value, w->cache);
+	else
+		insert(w->args->list, value, w->cache);
+	return 1;
+}
+
+/*************************************************
+ * Function: begin_delete
+ * Description: Waits until the list may be changed. Lightswitch: no searchers, inserters or deleters. Rcu and optimistic: no inserters or deleters, searchers keep going.
+ * Coupling and snapshot: nothing, the delete locks what it needs. Skiplist: enters an epoch read section. Fair and deleter policies: holds the turnstile while
+ * waiting so searchers and inserters arriving later queue up behind. Sharded: only waits for the shard the value belongs to.
+ * Params: Worker pointer, value to delete (sharded mode picks the shard with it)
  * Returns: None
- * Pre-conditions: None 
- * Post-conditions: Node corresponding to value has been removed and deallocated or no change if value is not present in list.
- *                  If head node is deleted, new head is updated or given NULL value.
+ * Pre-conditions: None
+ * Post-conditions: Caller may delete until end_delete
  * **********************************************/
-void delete(Node** node, int value)
+void begin_delete(Worker* w, int value)
 {
-	if(*node == NULL) //If list is empty or end of list reached
+	if(w->args->mode == MODE_COUPLING || w->args->mode == MODE_SNAPSHOT)
 		return;
-	
-	if((*node)->next != NULL)
+	if(w->args->mode == MODE_SKIPLIST)
 	{
-		if((*node)->next->value == value) //If the next node over has the value we want
-		{
-			Node* temp = (*node)->next; //Temporarily store the location of the node we're removing
-			(*node)->next = temp->next; //Direct current node to whatever follows the deleted node
-			free(temp); //Free the memory that temp points to
-			return;
-		}
+		epoch_enter(w->args->epoch, w->epoch);
+		return;
 	}
-	else if((*node)->value == value) //If current node we're at is the head
+	if(w->args->mode == MODE_SHARDED)
 	{
-		//Set the new head and free the current head
-		Node* temp = (*node)->next;
-		*node = (*node)->next;
-		free(temp);
+		w->shard = shard_of(w->args, value);
+		delete_lock(&w->shard->ex, w->args->policy, 1);
 		return;
 	}
-	delete(&(*node)->next, value);
+	delete_lock(w->args->ex, w->args->policy, w->args->mode != MODE_RCU && w->args->mode != MODE_OPTIMISTIC); //Their searchers never see freed nodes
 }
 
 /*************************************************
- * Function: delete_end
- * Description: Deletes a node from the end of the linked list. Deallocates node deleted.
- * Params: Pointer to Linked List node pointer (This is needed if the head will be deleted)
+ * Function: end_delete
+ * Description: Ends a delete started with begin_delete
+ * Params: Worker pointer
  * Returns: None
- * Pre-conditions: None
- * Post-conditions: End of the linked list is deleted and deallocated.
+ * Pre-conditions: begin_delete was called
+ * Post-conditions: None
  * **********************************************/
-void delete_end(Node** node)
+void end_delete(Worker* w)
 {
-	if(*node == NULL) //Empty list
+	if(w->args->mode == MODE_COUPLING || w->args->mode == MODE_SNAPSHOT)
+		return;
+	if(w->args->mode == MODE_SKIPLIST)
+	{
+		epoch_exit(w->epoch);
 		return;
+	}
+	if(w->args->mode == MODE_SHARDED)
+		delete_unlock(&w->shard->ex, w->args->policy, 1);
+	else
+		delete_unlock(w->args->ex, w->args->policy, w->args->mode != MODE_RCU && w->args->mode != MODE_OPTIMISTIC);
+}
 
-	if((*node)->next != NULL) //Is the next item null?
+/*************************************************
+ * Function: delete_value
+ * Description: Deletes the node at the end of the list, or in coupling, skiplist and sharded modes the node holding the value. Rcu, optimistic, coupling and skiplist
+ * modes retire the node to a reclaimer so it is only freed once no other thread can be on it; snapshot mode frees it once no snapshot holds it.
+ * Params: Worker pointer, value to delete (coupling, skiplist and sharded modes only)
+ * Returns: 1 if a node was deleted, 0 if the list is empty or the value is not in it
+ * Pre-conditions: Between begin_delete and end_delete
+ * Post-conditions: List is one node shorter unless nothing was found
+ * **********************************************/
+int delete_value(Worker* w, int value)
+{
+	if(w->args->mode == MODE_SHARDED)
+		return delete(&w->shard->list, value, w->cache);
+	if(w->args->mode == MODE_SNAPSHOT)
+		return vl_delete_end(w->args->versions);
+	if(w->args->mode == MODE_SKIPLIST)
+	{
+		Skip_node* node = sl_remove(w->args->skip, value);
+		if(node != NULL)
+			epoch_retire(w->args->epoch, w->epoch, node); //Still inside the read section, so it is freed two epochs after we leave at the earliest
+		return node != NULL;
+	}
+	if(w->args->mode == MODE_COUPLING)
+	{
+		Lock_node* node = ll_unlink(w->args->locked, value);
+		if(node != NULL)
+			epoch_retire(w->args->epoch, w->epoch, node);
+		return node != NULL;
+	}
+	else if(w->args->mode == MODE_OPTIMISTIC)
 	{
-		if((*node)->next->next == NULL) //Next item is the tail
+		Node* node = olc_unlink_end(w->args->list); //Searchers on it notice the version and start over
+		if(node != NULL)
+			epoch_retire(w->args->epoch, w->epoch, node);
+		return node != NULL;
+	}
+	else if(w->args->mode == MODE_RCU)
+	{
+		Node* node = rcu_unlink_end(w->args->list);
+		if(node != NULL && w->args->reclaim == RECLAIM_HAZARD)
+			hazard_retire(w->args->hazard, w->hazard, node);
+		else if(node != NULL)
+			epoch_retire(w->args->epoch, w->epoch, node);
+		return node != NULL;
+	}
+	else if(w->args->mode == MODE_UNROLLED)
+		return ul_delete_end(w->args->unrolled, w->cache);
+	else if(w->args->mode == MODE_MAPPED)
+		return mp_delete_end(w->args->mapped);
+	else if(w->args->list->tail == NULL)
+		return 0;
+	delete_end(w->args->list, w->cache);
+	return 1;
+}
+
+/*************************************************
+ * Function: insert_values
+ * Description: Appends several values in one insert section
+ * Params: Worker pointer, array of values, number of values
+ * Returns: Number of values inserted
+ * Pre-conditions: Between begin_insert and end_insert, mode has batches
+ * Post-conditions: Values are at the end of the list in array order
+ * **********************************************/
+int insert_values(Worker* w, int* values, int n)
+{
+	if(w->args->mode == MODE_UNROLLED)
+		return ul_append_many(w->args->unrolled, values, n, w->cache);
+	return append_many(w->args->list, values, n, w->cache);
+}
+
+/*************************************************
+ * Function: in_range
+ * Description: Predicate for delete_range
+ * Params: value, array of the lowest value to accept and the first value past the range
+ * Returns: 1 if the value is in the range, 0 otherwise
+ * Pre-conditions: None
+ * Post-conditions: None
+ * **********************************************/
+int in_range(int value, void* ctx)
+{
+	int* range = (int*)ctx;
+	return value >= range[0] && value < range[1];
+}
+
+/*************************************************
+ * Function: delete_range
+ * Description: Deletes every value from lo up to but not including hi in one delete section (one pass over the list)
+ * Params: Worker pointer, lowest value to delete, first value past the range
+ * Returns: Number of values deleted
+ * Pre-conditions: Between begin_delete and end_delete, mode has batches
+ * Post-conditions: No value in the range is left in the list
+ * **********************************************/
+int delete_range(Worker* w, int lo, int hi)
+{
+	int range[2] = { lo, hi };
+	if(w->args->mode == MODE_UNROLLED)
+		return ul_delete_if(w->args->unrolled, in_range, range, w->cache);
+	return delete_if(w->args->list, in_range, range, w->cache);
+}
+
+/*************************************************
+ * Function: searcher
+ * Description: Thread function for searcher threads. It will print each item from the linked list (Basically a search of the whole list) when there are no deleters in use
+ * (in rcu mode even while deleters are running)
+ * Params: Args_t pointer structure.
+ * Returns: None
+ * Pre-conditions: Arguments structure is properly filled out
+ * Post-conditions: None
+ * **********************************************/
+void* searcher(void* args)
+{
+	Worker w;
+	worker_init(&w, (Args_t*)args);
+	int val;
+	while(1)
+	{
+		val = prng()%w.args->keys; //Value to look up in skiplist mode
+		//Enforce semaphore for STDOUT usage
+		sem_wait(w.args->talk);
+		if(w.args->mode == MODE_COUPLING)
+			printf("[SEARCH-WAIT] Thread 0x%x is starting a hand over hand search.\n", w.id);
+		else if(w.args->mode == MODE_SKIPLIST)
+			printf("[SEARCH-WAIT] Thread 0x%x is looking up %d without locking.\n", w.id, val);
+		else if(w.args->mode == MODE_SNAPSHOT)
+			printf("[SEARCH-WAIT] Thread 0x%x is taking a snapshot of the list.\n", w.id);
+		else if(w.args->mode == MODE_SHARDED)
+			printf("[SEARCH-WAIT] Thread 0x%x will check each shard for active delete threads in turn.\n", w.id);
+		else
+			printf("[SEARCH-WAIT] Thread 0x%x is %s.\n", w.id, w.args->mode == MODE_RCU ? "entering a lock-free read section" :
+				w.args->mode == MODE_OPTIMISTIC ? "reading the list optimistically" : "checking for active delete threads");
+		sem_post(w.args->talk);
+		begin_search(&w);
+
+		sem_wait(w.args->talk);
+		if(w.args->mode == MODE_SKIPLIST)
+			printf("[SEARCH-ACTION] Thread 0x%x %s %d in the set.\n", w.id, search(&w, val, NULL) ? "found" : "did not find", val);
+		else if(w.args->mode == MODE_SNAPSHOT)
 		{
-			free((*node)->next);
-			(*node)->next = NULL;
-			return;
+			printf("[SEARCH-ACTION] Thread 0x%x is searching its snapshot, newest value first.\nList: ", w.id);
+			search(&w, val, stdout);
 		}
+		else
+		{
+			printf("[SEARCH-ACTION] Thread 0x%x is searching the list.\nList: ", w.id);
+			search(&w, val, stdout); //Search through the linked list
+		}
+		sem_post(w.args->talk);
+
+		sleep(prng()%3+1);
+
+		end_search(&w);
+		sleep(prng()%10+1); //Sleep for awhile before next attempt to search
 	}
-	else { //We're the head of the list
-		free(*node);
-		*node = NULL;
-		return;
+	return NULL;
+}
+
+/*************************************************
+ * Function: inserter
+ * Description: Thread function for inserter threads. It will insert an item onto the end of the linked list when there are no other inserters or deleters in use
+ * Params: Args_t pointer structure
+ * Returns: None
+ * Pre-conditions: Arguments structure is properly filled out
+ * Post-conditions: 
+ * **********************************************/
+void* inserter(void* args)
+{
+	Worker w;
+	worker_init(&w, (Args_t*)args);
+	int val, inserted, i;
+	int* values = w.args->batch > 0 ? (int*)malloc(sizeof(int)*w.args->batch) : NULL;
+	while(1)
+	{
+		val = prng()%w.args->keys; //Random value to add to the list
+		for(i = 0; i < w.args->batch; i++)
+			values[i] = i == 0 ? val : (int)(prng()%w.args->keys);
+		sem_wait(w.args->talk);
+		if(w.args->mode == MODE_COUPLING)
+			printf("[INSERT-WAIT] Thread 0x%x is locking the tail.\n", w.id);
+		else if(w.args->mode == MODE_SKIPLIST)
+			printf("[INSERT-WAIT] Thread 0x%x is looking for where %d goes.\n", w.id, val);
+		else if(w.args->mode == MODE_SNAPSHOT)
+			printf("[INSERT-WAIT] Thread 0x%x is publishing a new version.\n", w.id);
+		else if(w.args->mode == MODE_SHARDED)
+			printf("[INSERT-WAIT] Thread 0x%x is checking for active insert and delete threads in shard %d.\n", w.id, (int)(shard_of(w.args, val) - w.args->shards));
+		else
+			printf("[INSERT-WAIT] Thread 0x%x is checking for active insert and delete threads.\n", w.id);
+		sem_post(w.args->talk);
+		begin_insert(&w, val);
+
+		inserted = values ? insert_values(&w, values, w.args->batch) : insert_value(&w, val); //Insert into the list
+		sem_wait(w.args->talk);
+		if(values)
+			printf("[INSERT-ACTION] Thread: 0x%x inserted %d values starting with %d into the list.\n", w.id, inserted, val);
+		else if(inserted)
+			printf("[INSERT-ACTION] Thread: 0x%x inserted %d into the list.\n", w.id, val);
+		else if(w.args->mode == MODE_MAPPED)
+			printf("[INSERT-ACTION] Thread: 0x%x could not grow the image for %d.\n", w.id, val);
+		else
+			printf("[INSERT-ACTION] Thread: 0x%x found %d already in the set.\n", w.id, val);
+		sem_post(w.args->talk);
+
+		sleep(prng()%3+1); //Sleep between 1 and 3 seconds for insertion time
+
+		end_insert(&w);
+		sleep(prng()%10+1); //Sleep for awhile before next attempt to insert
+
 	}
-	delete_end(&(*node)->next);
+	return NULL;
 }
 
 /*************************************************
- * Function: free_list
- * Description: Deallocates all list items
- * Params: Pointer to Linked List node pointer (So we can set the values of the node pointers to NULL)
+ * Function: deleter
+ * Description: Thread function for deleter threads. Deletes an item from the end of the list if there are no searchers, deleters or inserter threads currently active (or queued to wait before).
+ * In rcu mode searchers do not hold deleters back. In coupling mode deletes a random value, only locking the nodes around it.
+ * Params: Args_t pointer structure
  * Returns: None
- * Pre-conditions: None 
- * Post-conditions: All nodes deallocated and set to NULL
+ * Pre-conditions: Arguments is properly filled out
+ * Post-conditions: None
  * **********************************************/
-void free_list(Node** node)
+void* deleter(void* args)
 {
-	if((*node) == NULL)
-		return;
-	free_list((*node)->next);
-	free(*node);
-	*node = NULL;
+	Worker w;
+	worker_init(&w, (Args_t*)args);
+	int val, deleted;
+	while(1)
+	{
+		val = prng()%w.args->keys; //Value to look for in coupling and skiplist modes, start of the range to delete in batches
+		sem_wait(w.args->talk);
+		if(w.args->mode == MODE_COUPLING)
+			printf("[DELETE-WAIT] Thread 0x%x is looking for %d hand over hand.\n", w.id, val);
+		else if(w.args->mode == MODE_SKIPLIST)
+			printf("[DELETE-WAIT] Thread 0x%x is looking for %d to remove.\n", w.id, val);
+		else if(w.args->mode == MODE_SNAPSHOT)
+			printf("[DELETE-WAIT] Thread 0x%x is publishing a new version.\n", w.id);
+		else if(w.args->mode == MODE_SHARDED)
+			printf("[DELETE-WAIT] Thread 0x%x is checking for active search, insert and delete threads in shard %d.\n", w.id, (int)(shard_of(w.args, val) - w.args->shards));
+		else
+			printf("[DELETE-WAIT] Thread 0x%x is checking for active %sinsert and delete threads.\n", w.id, w.args->mode == MODE_RCU || w.args->mode == MODE_OPTIMISTIC ? "" : "search, ");
+		sem_post(w.args->talk);
+		begin_delete(&w, val);
+
+		deleted = w.args->batch > 0 ? delete_range(&w, val, val + w.args->batch) : delete_value(&w, val); //Delete item from end of the list (or the value)
+		sem_wait(w.args->talk);
+		if(w.args->batch > 0)
+			printf("[DELETE-ACTION] Thread 0x%x deleted %d values from %d to %d.\n", w.id, deleted, val, val + w.args->batch - 1);
+		else if(w.args->mode == MODE_COUPLING || w.args->mode == MODE_SKIPLIST || w.args->mode == MODE_SHARDED)
+			printf("[DELETE-ACTION] Thread 0x%x %s %d %s the list.\n", w.id, deleted ? "deleted" : "found no", val, deleted ? "from" : "in");
+		else
+			printf("[DELETE-ACTION] Thread 0x%x deleted end of list.\n", w.id);
+		sem_post(w.args->talk);
+		sleep(prng()%3+1); //Sleep between 1 and 3 seconds during deletion
+
+		end_delete(&w);
+		sleep(prng()%10+1); //Sleep between 1 and 10 seconds before trying to delete again
+	}
+	return NULL;
 }
 
 /*************************************************
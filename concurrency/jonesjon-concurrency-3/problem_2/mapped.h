@@ -0,0 +1,384 @@
+#pragma once
+
+//////////////////////////////////////////////////////
+// Doubly linked list that lives in a memory mapped file, so it survives restarts.
+//
+// Links are byte offsets from the start of the mapping instead of pointers (0 is NULL, the header
+// sits there), so the image means the same thing wherever it gets mapped. Opening an existing
+// image maps it and reads its header, in constant time however many nodes it holds.
+//
+// The header keeps two checkpoints (head, tail, free list, size, ...) with a sequence number and a
+// checksum, and every change writes the older of the two, so a checkpoint torn by a crash is
+// caught by its checksum and the other one is used. Writes are ordered so the newest valid
+// checkpoint always describes a whole list:
+//   - New nodes are written before the checkpoint that links them in.
+//   - A node is only taken off the free list or put on it through fields the committed list does
+//     not look at, and the only link of a committed node changed before a checkpoint is the
+//     tail's next, which is past the end of the list the checkpoint describes (opening an image
+//     clears it).
+//   - Deleting the end clears the new tail's next only after the checkpoint is written.
+// Writes to a shared mapping reach the file even if the process dies, so this holds for crashes
+// of the process as is. With durable set every write is also flushed with msync before the next
+// one, so it holds for the whole machine going down too, at the cost of a disk flush per change.
+//
+// The mapping sits at the start of a large address space reservation and grows into it by
+// mapping the next chunk of the file, so nodes never move while searchers walk them.
+//
+// None of these functions synchronize. Callers enforce the searcher/inserter/deleter exclusion.
+//////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "waits.h"
+
+#define MAPPED_MAGIC 0x315453494c50414dULL //"MAPLIST1" in little endian, marks a list image
+#define MAPPED_HEADER 4096 //Bytes before the first node
+#define MAPPED_CHUNK (1 << 21) //Bytes the file grows by at a time
+#define MAPPED_RESERVE (1ULL << 36) //Address space the image may grow into (2^31 nodes)
+
+typedef struct Mapped_node {
+	int32_t value;
+	int32_t unused;
+	uint64_t next; //Offset of the next node, 0 at the tail
+	uint64_t prev;
+	uint64_t free_next; //Offset of the next free node while on the free list
+}Mapped_node;
+
+typedef struct Mapped_checkpoint {
+	uint64_t seq; //Higher is newer, 0 for a slot never written
+	uint64_t head;
+	uint64_t tail;
+	uint64_t free; //First node of the free list
+	uint64_t bump; //Offset of the first node never handed out
+	uint64_t size;
+	uint64_t checksum; //Of every field above
+}__attribute__((aligned(64))) Mapped_checkpoint;
+
+typedef struct Mapped_header {
+	uint64_t magic;
+	uint64_t node_size;
+	Mapped_checkpoint slot[2];
+}Mapped_header;
+
+typedef struct Mapped_list {
+	char* base; //Start of the mapping, NULL while closed
+	size_t length; //Bytes of the file mapped
+	int fd;
+	int durable; //msync every write before the next one
+	Mapped_checkpoint state; //Working copy of the newest checkpoint
+	int recovered; //Values the image held when it was opened
+	unsigned long long open_ns; //Time opening it took
+}Mapped_list;
+
+/*************************************************
+ * Function: mp_node
+ * Description: Turns an offset into a node pointer
+ * Params: Mapped_list pointer, offset
+ * Returns: Node at the offset
+ * Pre-conditions: offset is a node offset (not 0)
+ * Post-conditions: None
+ * **********************************************/
+Mapped_node* mp_node(Mapped_list* ml, uint64_t offset)
+{
+	return (Mapped_node*)(ml->base + offset);
+}
+
+/*************************************************
+ * Function: mp_checksum
+ * Description: FNV-1a hash over every field of a checkpoint but the checksum
+ * Params: Checkpoint pointer
+ * Returns: Checksum
+ * Pre-conditions: None
+ * Post-conditions: None
+ * **********************************************/
+uint64_t mp_checksum(Mapped_checkpoint* cp)
+{
+	uint64_t fields[6] = { cp->seq, cp->head, cp->tail, cp->free, cp->bump, cp->size };
+	const unsigned char* bytes = (const unsigned char*)fields;
+	uint64_t hash = 14695981039346656037ULL;
+	size_t i; for(i = 0; i < sizeof(fields); i++)
+		hash = (hash ^ bytes[i]) * 1099511628211ULL;
+	return hash;
+}
+
+/*************************************************
+ * Function: mp_flush
+ * Description: Orders a write before every later one: a compiler and CPU fence, and with durable an msync of the pages it touched
+ * Params: Mapped_list pointer, offset and length of what was written
+ * Returns: None
+ * Pre-conditions: None
+ * Post-conditions: Range reached the file before anything written after this call
+ * **********************************************/
+void mp_flush(Mapped_list* ml, uint64_t offset, size_t length)
+{
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if(!ml->durable)
+		return;
+	uint64_t page = sysconf(_SC_PAGESIZE);
+	uint64_t start = offset & ~(page - 1);
+	msync(ml->base + start, offset + length - start, MS_SYNC);
+}
+
+/*************************************************
+ * Function: mp_commit
+ * Description: Writes the working state over the older checkpoint, making every change since the last commit part of the image
+ * Params: Mapped_list pointer
+ * Returns: None
+ * Pre-conditions: Every node the state reaches has been written
+ * Post-conditions: Opening the image from now on finds this state
+ * **********************************************/
+void mp_commit(Mapped_list* ml)
+{
+	Mapped_header* header = (Mapped_header*)ml->base;
+	ml->state.seq++;
+	ml->state.checksum = mp_checksum(&ml->state);
+	Mapped_checkpoint* slot = &header->slot[ml->state.seq & 1];
+	__atomic_thread_fence(__ATOMIC_SEQ_CST); //Nodes were flushed as they were written, this keeps the checkpoint after them
+	*slot = ml->state;
+	mp_flush(ml, (char*)slot - ml->base, sizeof(Mapped_checkpoint));
+}
+
+/*************************************************
+ * Function: mp_grow
+ * Description: Extends the file by a chunk and maps it right after the current mapping
+ * Params: Mapped_list pointer
+ * Returns: 1 on success, 0 if the reservation is used up or the file can not grow
+ * Pre-conditions: Image is open
+ * Post-conditions: length grew by MAPPED_CHUNK on success
+ * **********************************************/
+int mp_grow(Mapped_list* ml)
+{
+	size_t length = ml->length + MAPPED_CHUNK;
+	if(length > MAPPED_RESERVE || ftruncate(ml->fd, length) != 0)
+		return 0;
+	if(mmap(ml->base + ml->length, MAPPED_CHUNK, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, ml->fd, ml->length) == MAP_FAILED)
+		return 0;
+	if(ml->durable)
+		fsync(ml->fd); //The new length has to be on disk before a checkpoint points past the old one
+	ml->length = length;
+	return 1;
+}
+
+/*************************************************
+ * Function: mp_alloc
+ * Description: Takes a node off the free list, or past the last node handed out, growing the file if needed
+ * Params: Mapped_list pointer
+ * Returns: Offset of an unused node, 0 if the file can not grow
+ * Pre-conditions: Image is open
+ * Post-conditions: Working state no longer counts the node as free (committed with the change that uses it)
+ * **********************************************/
+uint64_t mp_alloc(Mapped_list* ml)
+{
+	uint64_t offset = ml->state.free;
+	if(offset != 0)
+	{
+		ml->state.free = mp_node(ml, offset)->free_next;
+		return offset;
+	}
+	if(ml->state.bump + sizeof(Mapped_node) > ml->length && !mp_grow(ml))
+		return 0;
+	offset = ml->state.bump;
+	ml->state.bump += sizeof(Mapped_node);
+	return offset;
+}
+
+/*************************************************
+ * Function: mp_open
+ * Description: Maps a list image, creating an empty one if the file is empty or missing. An existing image is not read beyond its header.
+ * Params: Mapped_list pointer, path of the image, 1 to msync every write
+ * Returns: 0 on success, -1 if the file can not be opened or mapped or is not a list image (errno tells why, EINVAL for a bad image)
+ * Pre-conditions: Image is not open
+ * Post-conditions: List holds the values of the newest valid checkpoint
+ * **********************************************/
+int mp_open(Mapped_list* ml, const char* path, int durable)
+{
+	struct stat st;
+	unsigned long long start = now_ns();
+	ml->durable = durable;
+	ml->fd = open(path, O_RDWR | O_CREAT, 0644);
+	if(ml->fd < 0)
+		return -1;
+	if(fstat(ml->fd, &st) != 0 || (st.st_size > 0 && (st.st_size < MAPPED_HEADER || st.st_size % MAPPED_HEADER != 0)))
+	{
+		close(ml->fd);
+		errno = EINVAL;
+		return -1;
+	}
+	int fresh = st.st_size == 0;
+	if(fresh && ftruncate(ml->fd, MAPPED_HEADER + MAPPED_CHUNK) != 0)
+	{
+		close(ml->fd);
+		return -1;
+	}
+	ml->length = fresh ? MAPPED_HEADER + MAPPED_CHUNK : (size_t)st.st_size;
+
+	//Reserve room to grow, then map the file over the start of it
+	ml->base = (char*)mmap(NULL, MAPPED_RESERVE, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	if(ml->base == MAP_FAILED || mmap(ml->base, ml->length, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, ml->fd, 0) == MAP_FAILED)
+	{
+		if(ml->base != MAP_FAILED)
+			munmap(ml->base, MAPPED_RESERVE);
+		ml->base = NULL;
+		close(ml->fd);
+		return -1;
+	}
+
+	Mapped_header* header = (Mapped_header*)ml->base;
+	if(fresh)
+	{
+		header->magic = MAPPED_MAGIC;
+		header->node_size = sizeof(Mapped_node);
+		memset(&ml->state, 0, sizeof(Mapped_checkpoint));
+		ml->state.bump = MAPPED_HEADER;
+		mp_commit(ml);
+	}
+	else
+	{
+		//Newest checkpoint that was written out whole
+		Mapped_checkpoint* newest = NULL;
+		int i; for(i = 0; i < 2; i++)
+		{
+			Mapped_checkpoint* cp = &header->slot[i];
+			if(cp->seq != 0 && cp->checksum == mp_checksum(cp) && cp->bump <= ml->length && (newest == NULL || cp->seq > newest->seq))
+				newest = cp;
+		}
+		if(header->magic != MAPPED_MAGIC || header->node_size != sizeof(Mapped_node) || newest == NULL)
+		{
+			munmap(ml->base, MAPPED_RESERVE);
+			ml->base = NULL;
+			close(ml->fd);
+			errno = EINVAL;
+			return -1;
+		}
+		ml->state = *newest;
+		if(ml->state.tail != 0)
+			mp_node(ml, ml->state.tail)->next = 0; //May point at a node appended after the checkpoint
+	}
+	ml->recovered = ml->state.size;
+	ml->open_ns = now_ns() - start;
+	return 0;
+}
+
+/*************************************************
+ * Function: mp_walk
+ * Description: Visits every value in order, optionally printing them
+ * Params: Mapped_list pointer, stream to print to or NULL to just walk
+ * Returns: Number of values visited
+ * Pre-conditions: Image is open
+ * Post-conditions: None
+ * **********************************************/
+int mp_walk(Mapped_list* ml, FILE* out)
+{
+	int visited = 0;
+	uint64_t offset;
+	for(offset = ml->state.head; offset != 0; offset = mp_node(ml, offset)->next)
+	{
+		if(out)
+			fprintf(out, "%d, ", mp_node(ml, offset)->value);
+		visited++;
+	}
+	if(out)
+		fprintf(out, "\n");
+	return visited;
+}
+
+/*************************************************
+ * Function: mp_append
+ * Description: Appends a value and commits it
+ * Params: Mapped_list pointer, value
+ * Returns: 1 if the value was appended, 0 if the file can not grow
+ * Pre-conditions: Image is open
+ * Post-conditions: Value is at the end of the list and of the image
+ * **********************************************/
+int mp_append(Mapped_list* ml, int value)
+{
+	uint64_t offset = mp_alloc(ml);
+	if(offset == 0)
+		return 0;
+	Mapped_node* node = mp_node(ml, offset);
+	node->value = value;
+	node->next = 0;
+	node->prev = ml->state.tail;
+	mp_flush(ml, offset, sizeof(Mapped_node));
+
+	if(ml->state.tail == 0)
+		ml->state.head = offset;
+	else
+	{
+		mp_node(ml, ml->state.tail)->next = offset; //Past the end of the committed list until the commit
+		mp_flush(ml, ml->state.tail, sizeof(Mapped_node));
+	}
+	ml->state.tail = offset;
+	ml->state.size++;
+	mp_commit(ml);
+	return 1;
+}
+
+/*************************************************
+ * Function: mp_delete_end
+ * Description: Deletes the last value, putting its node on the free list, and commits it
+ * Params: Mapped_list pointer
+ * Returns: 1 if a value was deleted, 0 if the list is empty
+ * Pre-conditions: Image is open
+ * Post-conditions: List and image are one value shorter unless they were empty
+ * **********************************************/
+int mp_delete_end(Mapped_list* ml)
+{
+	uint64_t offset = ml->state.tail;
+	if(offset == 0)
+		return 0;
+	Mapped_node* node = mp_node(ml, offset);
+	uint64_t prev = node->prev;
+	node->free_next = ml->state.free; //Not a field the committed list uses
+	mp_flush(ml, offset, sizeof(Mapped_node));
+
+	ml->state.free = offset;
+	ml->state.tail = prev;
+	if(prev == 0)
+		ml->state.head = 0;
+	ml->state.size--;
+	mp_commit(ml);
+	if(prev != 0)
+	{
+		mp_node(ml, prev)->next = 0; //Only once the checkpoint ends the list here
+		mp_flush(ml, prev, sizeof(Mapped_node));
+	}
+	return 1;
+}
+
+/*************************************************
+ * Function: mp_size
+ * Description: Number of values in the list
+ * Params: Mapped_list pointer
+ * Returns: List length
+ * Pre-conditions: Image is open
+ * Post-conditions: None
+ * **********************************************/
+int mp_size(Mapped_list* ml)
+{
+	return (int)ml->state.size;
+}
+
+/*************************************************
+ * Function: mp_close
+ * Description: Unmaps the image, leaving the file holding the list for the next mp_open
+ * Params: Mapped_list pointer
+ * Returns: None
+ * Pre-conditions: No thread is using the list
+ * Post-conditions: Image is closed
+ * **********************************************/
+void mp_close(Mapped_list* ml)
+{
+	if(ml->base == NULL)
+		return;
+	munmap(ml->base, MAPPED_RESERVE);
+	close(ml->fd);
+	ml->base = NULL;
+}
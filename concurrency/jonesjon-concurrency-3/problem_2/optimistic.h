@@ -0,0 +1,172 @@
+#pragma once
+
+//////////////////////////////////////////////////////
+// Optimistic version validated access to the list in list.h (optimistic lock coupling).
+//
+// Every node and the list header carry a version, like a seqlock: a deleter makes it odd before
+// changing the link it guards and even again after, and leaves the version of the node it unlinks
+// odd for good. Readers take no locks and write nothing shared. They read a version, read what it
+// guards and check the version did not move, coupling hand over hand: the link to a node is
+// validated after the node's own version is read, so a reader only steps onto nodes that were still
+// linked. If a deleter changed anything the reader is standing on, it starts over from the head.
+//
+// Inserters only append, which never changes a link a reader already followed, so they publish
+// with release stores like rculist.h and bump no version. Unlinked nodes are retired to the epoch
+// reclaimer, so a reader that has not noticed yet still reads valid memory.
+//////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "list.h"
+
+/*************************************************
+ * Function: olc_read
+ * Description: Reads a version before reading what it guards
+ * Params: version pointer
+ * Returns: Version seen, odd if a deleter is changing it or the node is unlinked
+ * Pre-conditions: None
+ * Post-conditions: None
+ * **********************************************/
+unsigned int olc_read(unsigned int* version)
+{
+	return __atomic_load_n(version, __ATOMIC_ACQUIRE);
+}
+
+/*************************************************
+ * Function: olc_validate
+ * Description: Checks that nothing guarded by a version changed since olc_read
+ * Params: version pointer, version olc_read returned
+ * Returns: 1 if everything read in between is consistent, 0 if the reader has to start over
+ * Pre-conditions: None
+ * Post-conditions: None
+ * **********************************************/
+int olc_validate(unsigned int* version, unsigned int seen)
+{
+	__atomic_thread_fence(__ATOMIC_ACQUIRE); //Reads in between happen before the check
+	return __atomic_load_n(version, __ATOMIC_RELAXED) == seen;
+}
+
+/*************************************************
+ * Function: olc_write_begin
+ * Description: Makes a version odd before changing what it guards
+ * Params: version pointer
+ * Returns: None
+ * Pre-conditions: Caller excludes every other writer
+ * Post-conditions: Readers that read it from now on start over
+ * **********************************************/
+void olc_write_begin(unsigned int* version)
+{
+	__atomic_store_n(version, *version + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE); //The odd version is visible before any change
+}
+
+/*************************************************
+ * Function: olc_write_end
+ * Description: Makes a version even again once the change is done
+ * Params: version pointer
+ * Returns: None
+ * Pre-conditions: olc_write_begin was called on it
+ * Post-conditions: Readers may read it again, readers that saw it before the change start over
+ * **********************************************/
+void olc_write_end(unsigned int* version)
+{
+	__atomic_store_n(version, *version + 1, __ATOMIC_RELEASE);
+}
+
+/*************************************************
+ * Function: olc_walk
+ * Description: Visits every node without locks, validating each step and starting over if a deleter changed a node on the way
+ * Params: List pointer, stream to print to or NULL to just walk
+ * Returns: Number of nodes visited on the pass that got through
+ * Pre-conditions: Caller is inside an epoch read section of the reclaimer the deleters use
+ * Post-conditions: The pass that got through saw the list as it was at some point during the call
+ * **********************************************/
+int olc_walk(List* list, FILE* out)
+{
+	int visited;
+restart:
+	visited = 0;
+	unsigned int* version = &list->version;
+	unsigned int seen = olc_read(version);
+	if(seen & 1)
+		goto restart; //A deleter is emptying the list
+	Node* node = __atomic_load_n(&list->head, __ATOMIC_ACQUIRE);
+	while(node != NULL)
+	{
+		unsigned int node_seen = olc_read(&node->version);
+		if((node_seen & 1) || !olc_validate(version, seen))
+		{
+			if(out)
+				fprintf(out, "[changed, starting over]\n");
+			goto restart;
+		}
+		int value = __atomic_load_n(&node->value, __ATOMIC_RELAXED);
+		Node* next = __atomic_load_n(&node->next, __ATOMIC_ACQUIRE);
+		if(!olc_validate(&node->version, node_seen))
+		{
+			if(out)
+				fprintf(out, "[changed, starting over]\n");
+			goto restart;
+		}
+		if(out)
+			fprintf(out, "%d, ", value);
+		visited++;
+		version = &node->version;
+		seen = node_seen;
+		node = next;
+	}
+	if(out)
+		fprintf(out, "\n");
+	return visited;
+}
+
+/*************************************************
+ * Function: olc_insert
+ * Description: Appends a node in constant time and publishes it to optimistic readers
+ * Params: List pointer, integer value to be inserted as new node, pool cache (NULL for malloc)
+ * Returns: None
+ * Pre-conditions: Caller excludes every other writer
+ * Post-conditions: New node is reachable by readers that start after this returns
+ * **********************************************/
+void olc_insert(List* list, int value, Pool_cache* cache)
+{
+	Node* node = node_new(cache);
+	node->value = value;
+	node->version = 0; //A recycled node was left odd when it was unlinked
+	node->next = NULL;
+	node->prev = list->tail;
+
+	if(list->tail == NULL)
+		__atomic_store_n(&list->head, node, __ATOMIC_RELEASE);
+	else
+		__atomic_store_n(&list->tail->next, node, __ATOMIC_RELEASE);
+	list->tail = node;
+	list->size++;
+}
+
+/*************************************************
+ * Function: olc_unlink_end
+ * Description: Takes the last node out of the list in constant time without freeing it, bumping the versions readers validate against
+ * Params: List pointer
+ * Returns: Unlinked node, or NULL if the list is empty. Readers may still hold it until they validate.
+ * Pre-conditions: Caller excludes every other writer
+ * Post-conditions: Node's version stays odd, readers standing on it or its predecessor start over
+ * **********************************************/
+Node* olc_unlink_end(List* list)
+{
+	Node* node = list->tail;
+	if(node == NULL)
+		return NULL;
+
+	unsigned int* link = node->prev == NULL ? &list->version : &node->prev->version;
+	olc_write_begin(link);
+	olc_write_begin(&node->version);
+	if(node->prev == NULL)
+		__atomic_store_n(&list->head, NULL, __ATOMIC_RELAXED);
+	else
+		__atomic_store_n(&node->prev->next, NULL, __ATOMIC_RELAXED);
+	olc_write_end(link);
+	list->tail = node->prev;
+	list->size--;
+	return node;
+}
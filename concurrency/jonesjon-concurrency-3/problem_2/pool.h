@@ -0,0 +1,202 @@
+#pragma once
+
+//////////////////////////////////////////////////////
+// Fixed size node pool with per thread caches.
+//
+// Nodes are carved out of large cache line aligned slabs, so nodes allocated one after another sit
+// next to each other in memory instead of being scattered over the heap with malloc headers in
+// between. Every thread allocates from and frees to its own cache without any locking. When a cache
+// collects more than two batches of free nodes (deleters free what inserters allocated) it hands a
+// batch to a shared depot, and an empty cache takes a batch from the depot before it carves a new
+// slab. Once the slabs cover the peak list size nothing touches malloc or free again.
+//
+// A free node's first word links it to the next free node in the same batch; the first node of a
+// batch in the depot uses its second word to link to the next batch. Nodes must be at least two
+// pointers big. Slabs are only returned to the system by pool_destroy.
+//////////////////////////////////////////////////////
+
+#include <stdlib.h>
+#include <pthread.h>
+
+#define POOL_MAX_THREADS 256
+#define POOL_SLAB_NODES 4096 //Nodes carved out of each slab
+#define POOL_BATCH 256 //Nodes moved between a cache and the depot at once
+
+typedef struct Pool_cache {
+	struct Pool* pool;
+	void* free; //Free nodes of this thread
+	int count;
+}__attribute__((aligned(64))) Pool_cache;
+
+typedef struct Pool {
+	size_t size; //Bytes per node
+	pthread_mutex_t lock; //Guards batches and slabs
+	void* batches; //Depot of full batches
+	void** slabs;
+	int slab_count;
+	int slab_capacity;
+	int threads; //Caches handed out
+	Pool_cache cache[POOL_MAX_THREADS];
+}Pool;
+
+/*************************************************
+ * Function: pool_new
+ * Description: Creates an empty pool (the first slab is carved on the first allocation)
+ * Params: Bytes per node
+ * Returns: Pool pointer
+ * Pre-conditions: size is at least two pointers
+ * Post-conditions: No slabs and no caches handed out
+ * **********************************************/
+Pool* pool_new(size_t size)
+{
+	Pool* pool = (Pool*)aligned_alloc(64, sizeof(Pool));
+	pool->size = (size + sizeof(void*) - 1) / sizeof(void*) * sizeof(void*);
+	pthread_mutex_init(&pool->lock, NULL);
+	pool->batches = NULL;
+	pool->slabs = NULL;
+	pool->slab_count = 0;
+	pool->slab_capacity = 0;
+	pool->threads = 0;
+	int i; for(i = 0; i < POOL_MAX_THREADS; i++)
+	{
+		pool->cache[i].pool = pool;
+		pool->cache[i].free = NULL;
+		pool->cache[i].count = 0;
+	}
+	return pool;
+}
+
+/*************************************************
+ * Function: pool_register
+ * Description: Hands the calling thread its own cache. The cache outlives the thread so nodes retired by it can still be freed into it.
+ * Params: Pool pointer
+ * Returns: Cache to pass to pool_alloc and pool_free, NULL if POOL_MAX_THREADS caches are already out
+ * Pre-conditions: None
+ * Post-conditions: None
+ * **********************************************/
+Pool_cache* pool_register(Pool* pool)
+{
+	int i = __atomic_fetch_add(&pool->threads, 1, __ATOMIC_RELAXED);
+	if(i >= POOL_MAX_THREADS)
+		return NULL;
+	return &pool->cache[i];
+}
+
+/*************************************************
+ * Function: pool_refill
+ * Description: Fills an empty cache with a batch from the depot, or with a freshly carved slab if the depot is empty
+ * Params: Cache of the calling thread
+ * Returns: None
+ * Pre-conditions: Cache is empty
+ * Post-conditions: Cache has free nodes
+ * **********************************************/
+void pool_refill(Pool_cache* cache)
+{
+	Pool* pool = cache->pool;
+	pthread_mutex_lock(&pool->lock);
+	if(pool->batches != NULL)
+	{
+		cache->free = pool->batches;
+		pool->batches = ((void**)pool->batches)[1];
+		cache->count = POOL_BATCH;
+		pthread_mutex_unlock(&pool->lock);
+		return;
+	}
+
+	if(pool->slab_count == pool->slab_capacity)
+	{
+		pool->slab_capacity = pool->slab_capacity ? pool->slab_capacity * 2 : 16;
+		pool->slabs = (void**)realloc(pool->slabs, sizeof(void*)*pool->slab_capacity);
+	}
+	size_t bytes = (pool->size * POOL_SLAB_NODES + 63) / 64 * 64;
+	char* slab = (char*)aligned_alloc(64, bytes);
+	pool->slabs[pool->slab_count++] = slab;
+	pthread_mutex_unlock(&pool->lock);
+
+	int i; for(i = 0; i < POOL_SLAB_NODES - 1; i++)
+		*(void**)(slab + i * pool->size) = slab + (i + 1) * pool->size;
+	*(void**)(slab + i * pool->size) = NULL;
+	cache->free = slab;
+	cache->count = POOL_SLAB_NODES;
+}
+
+/*************************************************
+ * Function: pool_alloc
+ * Description: Takes a node from the calling thread's cache
+ * Params: Cache of the calling thread
+ * Returns: Uninitialized node of the pool's size
+ * Pre-conditions: Only the owning thread uses the cache
+ * Post-conditions: None
+ * **********************************************/
+void* pool_alloc(Pool_cache* cache)
+{
+	if(cache->free == NULL)
+		pool_refill(cache);
+	void* node = cache->free;
+	cache->free = *(void**)node;
+	cache->count--;
+	return node;
+}
+
+/*************************************************
+ * Function: pool_free
+ * Description: Puts a node back into the calling thread's cache, handing a batch to the depot when the cache gets too full
+ * Params: Cache of the calling thread, node from the same pool (allocated by any thread)
+ * Returns: None
+ * Pre-conditions: Only the owning thread uses the cache
+ * Post-conditions: Node may be handed out again
+ * **********************************************/
+void pool_free(Pool_cache* cache, void* node)
+{
+	*(void**)node = cache->free;
+	cache->free = node;
+	if(++cache->count < 2 * POOL_BATCH)
+		return;
+
+	void* first = cache->free;
+	void* last = first;
+	int i; for(i = 1; i < POOL_BATCH; i++)
+		last = *(void**)last;
+	cache->free = *(void**)last;
+	*(void**)last = NULL;
+	cache->count -= POOL_BATCH;
+
+	Pool* pool = cache->pool;
+	pthread_mutex_lock(&pool->lock);
+	((void**)first)[1] = pool->batches;
+	pool->batches = first;
+	pthread_mutex_unlock(&pool->lock);
+}
+
+/*************************************************
+ * Function: pool_bytes
+ * Description: Memory taken by the pool's slabs
+ * Params: Pool pointer
+ * Returns: Bytes allocated for slabs
+ * Pre-conditions: None
+ * Post-conditions: None
+ * **********************************************/
+size_t pool_bytes(Pool* pool)
+{
+	pthread_mutex_lock(&pool->lock);
+	size_t bytes = (size_t)pool->slab_count * ((pool->size * POOL_SLAB_NODES + 63) / 64 * 64);
+	pthread_mutex_unlock(&pool->lock);
+	return bytes;
+}
+
+/*************************************************
+ * Function: pool_destroy
+ * Description: Releases every slab, which frees every node of the pool at once, and the pool itself
+ * Params: Pool pointer
+ * Returns: None
+ * Pre-conditions: No thread uses any node or cache of the pool anymore
+ * Post-conditions: Pool pointer is invalid
+ * **********************************************/
+void pool_destroy(Pool* pool)
+{
+	int i; for(i = 0; i < pool->slab_count; i++)
+		free(pool->slabs[i]);
+	free(pool->slabs);
+	pthread_mutex_destroy(&pool->lock);
+	free(pool);
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+//////////////////////////////////////////////////////
+// Read-copy-update flavoured access to the list in list.h.
+//
+// Writers (one at a time, inserters and deleters still exclude each other) publish every pointer a
+// reader follows with a release store. Readers take no locks and write nothing shared: they follow
+// head and next with acquire loads. A node is fully set up before it becomes reachable, so a reader
+// either sees it whole or not at all.
+//
+// Deleting unlinks the node but does not free it, the caller hands it to a reclaimer that waits
+// until no reader can still be standing on it (epoch.h or hazard.h). Only head and next are read
+// without locks; tail, prev and size stay private to the writers.
+//
+// Nodes are only ever unlinked from the tail, so an unlinked node's next is NULL and stays NULL.
+// A reader holding a hazard on a node that gets unlinked under it simply reaches the end of the
+// list, it never has to start over from the head.
+//////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "list.h"
+#include "hazard.h"
+
+/*************************************************
+ * Function: rcu_walk
+ * Description: Visits every node without locks, optionally printing the values
+ * Params: List pointer, stream to print to or NULL to just walk
+ * Returns: Number of nodes visited
+ * Pre-conditions: Caller is inside a read section of the reclaimer the deleters use
+ * Post-conditions: None
+ * **********************************************/
+int rcu_walk(List* list, FILE* out)
+{
+	int visited = 0;
+	Node* node;
+	for(node = __atomic_load_n(&list->head, __ATOMIC_ACQUIRE); node != NULL; node = __atomic_load_n(&node->next, __ATOMIC_ACQUIRE))
+	{
+		if(out)
+			fprintf(out, "%d, ", node->value);
+		visited++;
+	}
+	if(out)
+		fprintf(out, "\n");
+	return visited;
+}
+
+/*************************************************
+ * Function: hazard_walk
+ * Description: Visits every node without locks, publishing each node in a hazard slot before touching it
+ * Params: List pointer, hazard record of the calling thread, stream to print to or NULL to just walk
+ * Returns: Number of nodes visited
+ * Pre-conditions: Deleters retire nodes to the hazard reclaimer the record belongs to
+ * Post-conditions: Record's slots are cleared
+ * **********************************************/
+int hazard_walk(List* list, Hazard_record* rec, FILE* out)
+{
+	int visited = 0, slot = 0;
+	Node* node = (Node*)hazard_protect(rec, slot, (void**)&list->head);
+	while(node != NULL)
+	{
+		if(out)
+			fprintf(out, "%d, ", node->value);
+		visited++;
+		slot ^= 1; //Keep node published while its successor gets published in the other slot
+		node = (Node*)hazard_protect(rec, slot, (void**)&node->next);
+	}
+	hazard_clear(rec);
+	if(out)
+		fprintf(out, "\n");
+	return visited;
+}
+
+/*************************************************
+ * Function: rcu_insert
+ * Description: Appends a node in constant time and publishes it to lock-free readers
+ * Params: List pointer, integer value to be inserted as new node, pool cache (NULL for malloc)
+ * Returns: None
+ * Pre-conditions: Caller excludes every other writer
+ * Post-conditions: New node is reachable by readers that start after this returns
+ * **********************************************/
+void rcu_insert(List* list, int value, Pool_cache* cache)
+{
+	Node* node = node_new(cache);
+	node->value = value;
+	node->next = NULL;
+	node->prev = list->tail;
+
+	if(list->tail == NULL)
+		__atomic_store_n(&list->head, node, __ATOMIC_RELEASE);
+	else
+		__atomic_store_n(&list->tail->next, node, __ATOMIC_RELEASE);
+	list->tail = node;
+	list->size++;
+}
+
+/*************************************************
+ * Function: rcu_unlink_end
+ * Description: Takes the last node out of the list in constant time without freeing it
+ * Params: List pointer
+ * Returns: Unlinked node, or NULL if the list is empty. Readers may still hold it.
+ * Pre-conditions: Caller excludes every other writer
+ * Post-conditions: Node is unreachable for readers that start after this returns
+ * **********************************************/
+Node* rcu_unlink_end(List* list)
+{
+	Node* node = list->tail;
+	if(node == NULL)
+		return NULL;
+
+	if(node->prev == NULL)
+		__atomic_store_n(&list->head, NULL, __ATOMIC_RELEASE);
+	else
+		__atomic_store_n(&node->prev->next, NULL, __ATOMIC_RELEASE);
+	list->tail = node->prev;
+	list->size--;
+	return node;
+}
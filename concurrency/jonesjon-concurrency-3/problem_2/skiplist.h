@@ -0,0 +1,330 @@
+#pragma once
+
+//////////////////////////////////////////////////////
+// Concurrent ordered set as a lazy skip list (Herlihy, Lev, Luchangco and Shavit).
+//
+// Every node is linked on levels 0..top, where top is picked at random with probability 1/2 per
+// extra level, so a lookup skips down from the sparse upper levels and takes O(log n) steps on
+// average. Lookups take no locks at all: contains just walks the levels and checks the flags of
+// the node it lands on.
+//
+// Adding and removing lock only the predecessors on each level (plus the victim when removing)
+// and then check nothing changed in between, retrying if it did. A node is only visible to
+// contains once it is fully linked, and removal first marks the node (from then on it is gone)
+// before unlinking it top down. Both always lock from the largest key down, so they can not
+// deadlock. Unlinked nodes may still be in use by lock-free walkers, so every operation runs in an
+// epoch read section and removed nodes are retired to the epoch reclaimer.
+//////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <pthread.h>
+
+#define SKIP_LEVELS 24 //Plenty for 2^24 keys
+
+typedef struct Skip_node {
+	int key;
+	int top; //Highest level the node is linked on
+	int marked; //Logically removed
+	int linked; //Linked on every level up to top
+	pthread_mutex_t lock;
+	struct Skip_node* next[]; //top + 1 links
+}Skip_node;
+
+typedef struct Skip_list {
+	Skip_node* head; //Sentinels on every level, keys INT_MIN and INT_MAX
+	Skip_node* tail;
+	int size;
+}Skip_list;
+
+/*************************************************
+ * Function: sl_node
+ * Description: Allocates a node with room for links on levels 0..top
+ * Params: key, highest level
+ * Returns: Unlinked, unmarked node
+ * Pre-conditions: top < SKIP_LEVELS
+ * Post-conditions: None
+ * **********************************************/
+Skip_node* sl_node(int key, int top)
+{
+	Skip_node* node = (Skip_node*)malloc(sizeof(Skip_node) + sizeof(Skip_node*)*(top + 1));
+	node->key = key;
+	node->top = top;
+	node->marked = 0;
+	node->linked = 0;
+	pthread_mutex_init(&node->lock, NULL);
+	return node;
+}
+
+/*************************************************
+ * Function: sl_init
+ * Description: Sets up an empty skip list
+ * Params: Skip_list pointer
+ * Returns: None
+ * Pre-conditions: None
+ * Post-conditions: Head links straight to tail on every level
+ * **********************************************/
+void sl_init(Skip_list* sl)
+{
+	sl->head = sl_node(INT_MIN, SKIP_LEVELS - 1);
+	sl->tail = sl_node(INT_MAX, SKIP_LEVELS - 1);
+	int level; for(level = 0; level < SKIP_LEVELS; level++)
+	{
+		sl->head->next[level] = sl->tail;
+		sl->tail->next[level] = NULL;
+	}
+	sl->head->linked = 1;
+	sl->tail->linked = 1;
+	sl->size = 0;
+}
+
+/*************************************************
+ * Function: sl_level
+ * Description: Picks the top level of a new node, each level up with probability 1/2
+ * Params: Per thread random state
+ * Returns: Level between 0 and SKIP_LEVELS - 1
+ * Pre-conditions: None
+ * Post-conditions: None
+ * **********************************************/
+int sl_level(unsigned int* seed)
+{
+	int top = 0;
+	while(top < SKIP_LEVELS - 1 && (rand_r(seed) & 1))
+		top++;
+	return top;
+}
+
+/*************************************************
+ * Function: sl_find
+ * Description: Finds the last node before the key and the first node at or after it on every level, without locking
+ * Params: Skip_list pointer, key, arrays of SKIP_LEVELS predecessors and successors to fill
+ * Returns: Highest level a node with the key was found on, -1 if none was found
+ * Pre-conditions: Inside an epoch read section
+ * Post-conditions: None
+ * **********************************************/
+int sl_find(Skip_list* sl, int key, Skip_node** preds, Skip_node** succs)
+{
+	int found = -1, level;
+	Skip_node* pred = sl->head;
+	for(level = SKIP_LEVELS - 1; level >= 0; level--)
+	{
+		Skip_node* node = __atomic_load_n(&pred->next[level], __ATOMIC_ACQUIRE);
+		while(key > node->key)
+		{
+			pred = node;
+			node = __atomic_load_n(&pred->next[level], __ATOMIC_ACQUIRE);
+		}
+		if(found == -1 && key == node->key)
+			found = level;
+		preds[level] = pred;
+		succs[level] = node;
+	}
+	return found;
+}
+
+/*************************************************
+ * Function: sl_contains
+ * Description: Looks a key up without taking any lock
+ * Params: Skip_list pointer, key
+ * Returns: 1 if the key is in the set, 0 otherwise
+ * Pre-conditions: Inside an epoch read section
+ * Post-conditions: None
+ * **********************************************/
+int sl_contains(Skip_list* sl, int key)
+{
+	Skip_node* preds[SKIP_LEVELS];
+	Skip_node* succs[SKIP_LEVELS];
+	int found = sl_find(sl, key, preds, succs);
+	return found != -1 && __atomic_load_n(&succs[found]->linked, __ATOMIC_ACQUIRE) && !__atomic_load_n(&succs[found]->marked, __ATOMIC_ACQUIRE);
+}
+
+/*************************************************
+ * Function: sl_unlock_preds
+ * Description: Unlocks the predecessors locked on levels 0..highest (a node that is the predecessor on several levels was locked once)
+ * Params: Array of predecessors, highest level locked
+ * Returns: None
+ * Pre-conditions: The predecessors were locked bottom up skipping repeats
+ * Post-conditions: None of them is locked by the caller
+ * **********************************************/
+void sl_unlock_preds(Skip_node** preds, int highest)
+{
+	int level; for(level = 0; level <= highest; level++)
+	{
+		if(level == 0 || preds[level] != preds[level - 1])
+			pthread_mutex_unlock(&preds[level]->lock);
+	}
+}
+
+/*************************************************
+ * Function: sl_add
+ * Description: Adds a key if it is not in the set yet
+ * Params: Skip_list pointer, key, per thread random state
+ * Returns: 1 if the key was added, 0 if it was already there
+ * Pre-conditions: Inside an epoch read section, key is between INT_MIN and INT_MAX exclusive
+ * Post-conditions: Key is in the set
+ * **********************************************/
+int sl_add(Skip_list* sl, int key, unsigned int* seed)
+{
+	Skip_node* preds[SKIP_LEVELS];
+	Skip_node* succs[SKIP_LEVELS];
+	int top = sl_level(seed);
+	while(1)
+	{
+		int found = sl_find(sl, key, preds, succs);
+		if(found != -1)
+		{
+			Skip_node* node = succs[found];
+			if(!__atomic_load_n(&node->marked, __ATOMIC_ACQUIRE))
+			{
+				while(!__atomic_load_n(&node->linked, __ATOMIC_ACQUIRE))
+					; //Someone else is adding it right now
+				return 0;
+			}
+			continue; //Being removed, try again once it is gone
+		}
+
+		int highest = -1, valid = 1, level;
+		for(level = 0; valid && level <= top; level++)
+		{
+			if(level == 0 || preds[level] != preds[level - 1])
+				pthread_mutex_lock(&preds[level]->lock);
+			highest = level;
+			valid = !preds[level]->marked && !__atomic_load_n(&succs[level]->marked, __ATOMIC_ACQUIRE) && preds[level]->next[level] == succs[level];
+		}
+		if(!valid)
+		{
+			sl_unlock_preds(preds, highest);
+			continue;
+		}
+
+		Skip_node* node = sl_node(key, top);
+		for(level = 0; level <= top; level++)
+			node->next[level] = succs[level];
+		for(level = 0; level <= top; level++)
+			__atomic_store_n(&preds[level]->next[level], node, __ATOMIC_RELEASE);
+		__atomic_store_n(&node->linked, 1, __ATOMIC_RELEASE);
+		__atomic_fetch_add(&sl->size, 1, __ATOMIC_RELAXED);
+		sl_unlock_preds(preds, highest);
+		return 1;
+	}
+}
+
+/*************************************************
+ * Function: sl_remove
+ * Description: Removes a key from the set
+ * Params: Skip_list pointer, key
+ * Returns: Unlinked node to retire, NULL if the key was not in the set
+ * Pre-conditions: Inside an epoch read section
+ * Post-conditions: Key is not in the set
+ * **********************************************/
+Skip_node* sl_remove(Skip_list* sl, int key)
+{
+	Skip_node* preds[SKIP_LEVELS];
+	Skip_node* succs[SKIP_LEVELS];
+	Skip_node* victim = NULL;
+	while(1)
+	{
+		int found = sl_find(sl, key, preds, succs);
+		if(victim == NULL)
+		{
+			if(found == -1)
+				return NULL;
+			victim = succs[found];
+			//Only remove a node that is fully linked and was found on its top level (not a half added one)
+			if(!__atomic_load_n(&victim->linked, __ATOMIC_ACQUIRE) || victim->top != found)
+				return NULL;
+			pthread_mutex_lock(&victim->lock);
+			if(victim->marked)
+			{
+				pthread_mutex_unlock(&victim->lock);
+				return NULL; //Somebody else is removing it
+			}
+			__atomic_store_n(&victim->marked, 1, __ATOMIC_RELEASE);
+		}
+
+		int highest = -1, valid = 1, level;
+		for(level = 0; valid && level <= victim->top; level++)
+		{
+			if(level == 0 || preds[level] != preds[level - 1])
+				pthread_mutex_lock(&preds[level]->lock);
+			highest = level;
+			valid = !preds[level]->marked && preds[level]->next[level] == victim;
+		}
+		if(!valid)
+		{
+			sl_unlock_preds(preds, highest);
+			continue; //Neighbourhood changed, find the predecessors again (victim stays marked and locked)
+		}
+
+		for(level = victim->top; level >= 0; level--)
+			__atomic_store_n(&preds[level]->next[level], victim->next[level], __ATOMIC_RELEASE);
+		pthread_mutex_unlock(&victim->lock);
+		sl_unlock_preds(preds, highest);
+		__atomic_fetch_sub(&sl->size, 1, __ATOMIC_RELAXED);
+		return victim;
+	}
+}
+
+/*************************************************
+ * Function: sl_walk
+ * Description: Visits every key in order along the bottom level, optionally printing them
+ * Params: Skip_list pointer, stream to print to or NULL to just walk
+ * Returns: Number of keys visited
+ * Pre-conditions: Inside an epoch read section
+ * Post-conditions: None
+ * **********************************************/
+int sl_walk(Skip_list* sl, FILE* out)
+{
+	int visited = 0;
+	Skip_node* node;
+	for(node = __atomic_load_n(&sl->head->next[0], __ATOMIC_ACQUIRE); node != sl->tail; node = __atomic_load_n(&node->next[0], __ATOMIC_ACQUIRE))
+	{
+		if(__atomic_load_n(&node->marked, __ATOMIC_ACQUIRE))
+			continue;
+		if(out)
+			fprintf(out, "%d, ", node->key);
+		visited++;
+	}
+	if(out)
+		fprintf(out, "\n");
+	return visited;
+}
+
+/*************************************************
+ * Function: sl_free_node
+ * Description: Frees one unlinked node (the reclaim function for the epoch reclaimer)
+ * Params: Reclaim context (unused), Skip_node pointer
+ * Returns: None
+ * Pre-conditions: Nobody can reach the node anymore
+ * Post-conditions: Node is freed
+ * **********************************************/
+void sl_free_node(void* ctx, void* ptr)
+{
+	(void)ctx;
+	Skip_node* node = (Skip_node*)ptr;
+	pthread_mutex_destroy(&node->lock);
+	free(node);
+}
+
+/*************************************************
+ * Function: sl_free
+ * Description: Deallocates every node including the sentinels
+ * Params: Skip_list pointer
+ * Returns: None
+ * Pre-conditions: No thread is using the list
+ * Post-conditions: sl_init has to be called before the list is used again
+ * **********************************************/
+void sl_free(Skip_list* sl)
+{
+	Skip_node* node = sl->head;
+	while(node != NULL)
+	{
+		Skip_node* next = node->next[0];
+		sl_free_node(NULL, node);
+		node = next;
+	}
+	sl->head = NULL;
+	sl->tail = NULL;
+	sl->size = 0;
+}
@@ -0,0 +1,218 @@
+#pragma once
+
+//////////////////////////////////////////////////////
+// Versioned list with O(1) snapshots through structure sharing.
+//
+// Nodes are never changed once published. The list is kept newest value first, so appending
+// makes one new node that points at the current version, and deleting the end publishes the
+// next node as the new version. Either way every older version stays intact and shares all of
+// its nodes with the newer ones.
+//
+// A snapshot is just a counted reference to the first node of the current version, taken under
+// a lock that is only held for that load and increment. Its reader can walk it for as long as it
+// likes while writers publish new versions. Every node counts the references to it (the current
+// version, snapshots and the node in front of it); dropping the last one frees the node and drops
+// its reference to the next, so a deleted value is freed when the last snapshot holding it is
+// released. Writers are serialized by their own lock and never wait for readers.
+//////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+typedef struct Version_node {
+	int value;
+	int refs;
+	struct Version_node* next; //Older value
+}Version_node;
+
+typedef struct Versioned_list {
+	Version_node* root; //First node of the current version, NULL when empty
+	pthread_mutex_t lock; //Guards root while a snapshot takes its reference
+	pthread_mutex_t write; //Serializes inserts and deletes
+	int length; //Values in the current version
+	long nodes; //Allocated nodes, current version or not
+}Versioned_list;
+
+/*************************************************
+ * Function: vl_init
+ * Description: Sets up an empty list
+ * Params: Versioned_list pointer
+ * Returns: None
+ * Pre-conditions: None
+ * Post-conditions: Current version is empty
+ * **********************************************/
+void vl_init(Versioned_list* list)
+{
+	list->root = NULL;
+	pthread_mutex_init(&list->lock, NULL);
+	pthread_mutex_init(&list->write, NULL);
+	list->length = 0;
+	list->nodes = 0;
+}
+
+/*************************************************
+ * Function: vl_snapshot
+ * Description: Takes the current version in constant time
+ * Params: Versioned_list pointer
+ * Returns: First node of the snapshot (NULL for an empty one), to be passed to vl_release
+ * Pre-conditions: None
+ * Post-conditions: Snapshot stays unchanged and allocated until released
+ * **********************************************/
+Version_node* vl_snapshot(Versioned_list* list)
+{
+	pthread_mutex_lock(&list->lock);
+	Version_node* snap = list->root;
+	if(snap != NULL)
+		__atomic_fetch_add(&snap->refs, 1, __ATOMIC_RELAXED);
+	pthread_mutex_unlock(&list->lock);
+	return snap;
+}
+
+/*************************************************
+ * Function: vl_release
+ * Description: Drops one reference to a node, freeing it and every older node no version or snapshot holds anymore
+ * Params: Versioned_list pointer, node (NULL does nothing)
+ * Returns: None
+ * Pre-conditions: Caller owns the reference
+ * Post-conditions: Node must not be used by the caller anymore
+ * **********************************************/
+void vl_release(Versioned_list* list, Version_node* node)
+{
+	while(node != NULL && __atomic_sub_fetch(&node->refs, 1, __ATOMIC_ACQ_REL) == 0)
+	{
+		Version_node* next = node->next; //The freed node's reference to next is dropped on the next pass
+		free(node);
+		__atomic_fetch_sub(&list->nodes, 1, __ATOMIC_RELAXED);
+		node = next;
+	}
+}
+
+/*************************************************
+ * Function: vl_walk
+ * Description: Visits every value of a snapshot, newest first, optionally printing them
+ * Params: First node of the snapshot, stream to print to or NULL to just walk
+ * Returns: Number of values visited
+ * Pre-conditions: Caller holds the snapshot
+ * Post-conditions: None
+ * **********************************************/
+int vl_walk(Version_node* snap, FILE* out)
+{
+	int visited = 0;
+	Version_node* node;
+	for(node = snap; node != NULL; node = node->next)
+	{
+		if(out)
+			fprintf(out, "%d, ", node->value);
+		visited++;
+	}
+	if(out)
+		fprintf(out, "\n");
+	return visited;
+}
+
+/*************************************************
+ * Function: vl_publish
+ * Description: Makes a node the first node of the current version
+ * Params: Versioned_list pointer, node whose reference the list takes over
+ * Returns: Previous first node, whose reference the caller takes over
+ * Pre-conditions: Caller holds the write lock
+ * Post-conditions: Snapshots taken from now on see the new version
+ * **********************************************/
+Version_node* vl_publish(Versioned_list* list, Version_node* node)
+{
+	pthread_mutex_lock(&list->lock);
+	Version_node* old = list->root;
+	list->root = node;
+	pthread_mutex_unlock(&list->lock);
+	return old;
+}
+
+/*************************************************
+ * Function: vl_append
+ * Description: Publishes a version with one more value at the end, in constant time
+ * Params: Versioned_list pointer, value
+ * Returns: None
+ * Pre-conditions: None
+ * Post-conditions: Current version ends with the value
+ * **********************************************/
+void vl_append(Versioned_list* list, int value)
+{
+	Version_node* node = (Version_node*)malloc(sizeof(Version_node));
+	node->value = value;
+	node->refs = 1; //The current version
+	__atomic_fetch_add(&list->nodes, 1, __ATOMIC_RELAXED);
+
+	pthread_mutex_lock(&list->write);
+	node->next = list->root; //Takes over the current version's reference to it
+	vl_publish(list, node);
+	__atomic_store_n(&list->length, list->length + 1, __ATOMIC_RELAXED);
+	pthread_mutex_unlock(&list->write);
+}
+
+/*************************************************
+ * Function: vl_delete_end
+ * Description: Publishes a version without the last value, in constant time. The node is freed once no snapshot holds it.
+ * Params: Versioned_list pointer
+ * Returns: 1 if a value was deleted, 0 if the list is empty
+ * Pre-conditions: None
+ * Post-conditions: Current version is one value shorter unless it was empty
+ * **********************************************/
+int vl_delete_end(Versioned_list* list)
+{
+	pthread_mutex_lock(&list->write);
+	Version_node* old = list->root;
+	if(old == NULL)
+	{
+		pthread_mutex_unlock(&list->write);
+		return 0;
+	}
+	if(old->next != NULL)
+		__atomic_fetch_add(&old->next->refs, 1, __ATOMIC_RELAXED); //For the new version, old keeps its own
+	vl_publish(list, old->next);
+	__atomic_store_n(&list->length, list->length - 1, __ATOMIC_RELAXED);
+	pthread_mutex_unlock(&list->write);
+	vl_release(list, old);
+	return 1;
+}
+
+/*************************************************
+ * Function: vl_length
+ * Description: Number of values in the current version
+ * Params: Versioned_list pointer
+ * Returns: List length
+ * Pre-conditions: None
+ * Post-conditions: None
+ * **********************************************/
+int vl_length(Versioned_list* list)
+{
+	return __atomic_load_n(&list->length, __ATOMIC_RELAXED);
+}
+
+/*************************************************
+ * Function: vl_pending
+ * Description: Counts nodes only older snapshots still hold
+ * Params: Versioned_list pointer
+ * Returns: Allocated nodes that are not in the current version (approximate while writers run)
+ * Pre-conditions: None
+ * Post-conditions: None
+ * **********************************************/
+long vl_pending(Versioned_list* list)
+{
+	return __atomic_load_n(&list->nodes, __ATOMIC_RELAXED) - vl_length(list);
+}
+
+/*************************************************
+ * Function: vl_free
+ * Description: Drops the current version, freeing every node
+ * Params: Versioned_list pointer
+ * Returns: None
+ * Pre-conditions: No thread is using the list and every snapshot was released
+ * Post-conditions: List is empty
+ * **********************************************/
+void vl_free(Versioned_list* list)
+{
+	vl_release(list, list->root);
+	list->root = NULL;
+	list->length = 0;
+}
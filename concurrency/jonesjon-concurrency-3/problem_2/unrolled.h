@@ -0,0 +1,234 @@
+#pragma once
+
+//////////////////////////////////////////////////////
+// Unrolled doubly linked list: every node is one 64 byte cache line holding up to UNROLL_VALUES
+// values next to each other.
+//
+// A walk touches one cache line per UNROLL_VALUES values instead of one scattered allocation per
+// value, and appending or deleting the last value only allocates or frees a node once every
+// UNROLL_VALUES operations. Values are kept in list order and fill each node from the front; a
+// value removed from the middle of a node has the rest of the node moved up to close the gap.
+//
+// Nodes come from the calling thread's pool cache, or from aligned_alloc when the cache is NULL.
+// None of these functions synchronize, callers enforce the searcher/inserter/deleter exclusion.
+//////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pool.h"
+
+#define UNROLL_VALUES 11 //Fills the cache line together with the links and the count
+
+typedef struct Unrolled_node {
+	struct Unrolled_node* next;
+	struct Unrolled_node* prev;
+	int count; //Values in use, always at least 1 for a node in the list
+	int values[UNROLL_VALUES];
+}__attribute__((aligned(64))) Unrolled_node;
+
+typedef struct Unrolled_list {
+	Unrolled_node* head;
+	Unrolled_node* tail;
+	int size; //Values
+	int nodes;
+}Unrolled_list;
+
+/*************************************************
+ * Function: ul_init
+ * Description: Sets up an empty list
+ * Params: Unrolled_list pointer
+ * Returns: None
+ * Pre-conditions: None
+ * Post-conditions: List has no nodes
+ * **********************************************/
+void ul_init(Unrolled_list* list)
+{
+	list->head = NULL;
+	list->tail = NULL;
+	list->size = 0;
+	list->nodes = 0;
+}
+
+/*************************************************
+ * Function: ul_walk
+ * Description: Visits every value, optionally printing it
+ * Params: Unrolled_list pointer, stream to print to or NULL to just walk
+ * Returns: Number of values visited
+ * Pre-conditions: None
+ * Post-conditions: None
+ * **********************************************/
+int ul_walk(Unrolled_list* list, FILE* out)
+{
+	int visited = 0, i;
+	Unrolled_node* node;
+	for(node = list->head; node != NULL; node = node->next)
+	{
+		if(out)
+		{
+			for(i = 0; i < node->count; i++)
+				fprintf(out, "%d, ", node->values[i]);
+		}
+		visited += node->count;
+	}
+	if(out)
+		fprintf(out, "\n");
+	return visited;
+}
+
+/*************************************************
+ * Function: ul_append
+ * Description: Appends a value in constant time, only allocating a node when the tail node is full
+ * Params: Unrolled_list pointer, value, pool cache (NULL for aligned_alloc)
+ * Returns: None
+ * Pre-conditions: The cache's pool was created for sizeof(Unrolled_node)
+ * Post-conditions: Value is at the end of the list
+ * **********************************************/
+void ul_append(Unrolled_list* list, int value, Pool_cache* cache)
+{
+	Unrolled_node* tail = list->tail;
+	if(tail == NULL || tail->count == UNROLL_VALUES)
+	{
+		Unrolled_node* node = cache ? (Unrolled_node*)pool_alloc(cache) : (Unrolled_node*)aligned_alloc(64, sizeof(Unrolled_node));
+		node->next = NULL;
+		node->prev = tail;
+		node->count = 0;
+		if(tail == NULL)
+			list->head = node;
+		else
+			tail->next = node;
+		list->tail = node;
+		list->nodes++;
+		tail = node;
+	}
+	tail->values[tail->count++] = value;
+	list->size++;
+}
+
+/*************************************************
+ * Function: ul_append_many
+ * Description: Appends several values in order, filling the tail node before allocating new ones
+ * Params: Unrolled_list pointer, array of values, number of values, pool cache (NULL for aligned_alloc)
+ * Returns: Number of values appended
+ * Pre-conditions: values holds n values
+ * Post-conditions: Values are at the end of the list in array order
+ * **********************************************/
+int ul_append_many(Unrolled_list* list, int* values, int n, Pool_cache* cache)
+{
+	int i; for(i = 0; i < n; i++)
+		ul_append(list, values[i], cache);
+	return n;
+}
+
+/*************************************************
+ * Function: ul_remove_at
+ * Description: Removes one value from a node, closing the gap, and frees the node if it becomes empty
+ * Params: Unrolled_list pointer, node in the list, index of the value, pool cache (NULL for free)
+ * Returns: None
+ * Pre-conditions: index < node->count
+ * Post-conditions: List is one value shorter
+ * **********************************************/
+void ul_remove_at(Unrolled_list* list, Unrolled_node* node, int index, Pool_cache* cache)
+{
+	memmove(&node->values[index], &node->values[index + 1], sizeof(int)*(node->count - index - 1));
+	node->count--;
+	list->size--;
+	if(node->count > 0)
+		return;
+
+	if(node->prev == NULL)
+		list->head = node->next;
+	else
+		node->prev->next = node->next;
+	if(node->next == NULL)
+		list->tail = node->prev;
+	else
+		node->next->prev = node->prev;
+	list->nodes--;
+
+	if(cache)
+		pool_free(cache, node);
+	else
+		free(node);
+}
+
+/*************************************************
+ * Function: ul_delete_end
+ * Description: Deletes the last value in constant time
+ * Params: Unrolled_list pointer, pool cache (NULL for free)
+ * Returns: 1 if a value was deleted, 0 if the list is empty
+ * Pre-conditions: None
+ * Post-conditions: List is one value shorter unless it was empty
+ * **********************************************/
+int ul_delete_end(Unrolled_list* list, Pool_cache* cache)
+{
+	if(list->tail == NULL)
+		return 0;
+	ul_remove_at(list, list->tail, list->tail->count - 1, cache);
+	return 1;
+}
+
+/*************************************************
+ * Function: ul_delete_if
+ * Description: Deletes every value the predicate accepts in one pass, packing the rest of each node in place and freeing nodes that end up empty
+ * Params: Unrolled_list pointer, predicate (value, context) returning non zero to delete, context handed to the predicate, pool cache (NULL for free)
+ * Returns: Number of values deleted
+ * Pre-conditions: None
+ * Post-conditions: No value left in the list is accepted by the predicate, the rest keep their order
+ * **********************************************/
+int ul_delete_if(Unrolled_list* list, int (*pred)(int, void*), void* ctx, Pool_cache* cache)
+{
+	int deleted = 0;
+	Unrolled_node* node = list->head;
+	while(node != NULL)
+	{
+		Unrolled_node* next = node->next;
+		int kept = 0, i;
+		for(i = 0; i < node->count; i++)
+		{
+			if(!pred(node->values[i], ctx))
+				node->values[kept++] = node->values[i];
+		}
+		deleted += node->count - kept;
+		list->size -= node->count - kept;
+		node->count = kept;
+		if(kept == 0)
+		{
+			if(node->prev == NULL)
+				list->head = next;
+			else
+				node->prev->next = next;
+			if(next == NULL)
+				list->tail = node->prev;
+			else
+				next->prev = node->prev;
+			list->nodes--;
+			if(cache)
+				pool_free(cache, node);
+			else
+				free(node);
+		}
+		node = next;
+	}
+	return deleted;
+}
+
+/*************************************************
+ * Function: ul_free
+ * Description: Deallocates all list nodes
+ * Params: Unrolled_list pointer
+ * Returns: None
+ * Pre-conditions: Nodes came from aligned_alloc (pooled nodes are released all at once with pool_destroy)
+ * Post-conditions: All nodes deallocated and the list is empty
+ * **********************************************/
+void ul_free(Unrolled_list* list)
+{
+	Unrolled_node* node = list->head;
+	while(node != NULL)
+	{
+		Unrolled_node* next = node->next;
+		free(node);
+		node = next;
+	}
+	ul_init(list);
+}
@@ -0,0 +1,126 @@
+#pragma once
+
+//////////////////////////////////////////////////////
+// Per thread wait samples and percentiles.
+// Each thread owns its Wait_stats, so recording needs no synchronization.
+//////////////////////////////////////////////////////
+
+#include <stdlib.h>
+#include <time.h>
+#include <limits.h>
+
+typedef struct Wait_stats {
+	unsigned int* ns; //Every wait in nanoseconds (clamped to about 4.3 seconds)
+	int count;
+	int capacity;
+}Wait_stats;
+
+/*************************************************
+ * Function: now_ns
+ * Description: Reads the monotonic clock
+ * Params: None
+ * Returns: Nanoseconds since an arbitrary fixed point
+ * Pre-conditions: None
+ * Post-conditions: None
+ * **********************************************/
+unsigned long long now_ns()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*************************************************
+ * Function: ws_add
+ * Description: Records one wait, growing the sample array as needed
+ * Params: Wait_stats pointer, wait in nanoseconds
+ * Returns: None
+ * Pre-conditions: Wait_stats was zeroed before first use
+ * Post-conditions: Sample is stored
+ * **********************************************/
+void ws_add(Wait_stats* ws, unsigned long long ns)
+{
+	if(ws->count == ws->capacity)
+	{
+		ws->capacity = ws->capacity ? ws->capacity * 2 : 1024;
+		ws->ns = (unsigned int*)realloc(ws->ns, sizeof(unsigned int)*ws->capacity);
+	}
+	ws->ns[ws->count++] = ns > UINT_MAX ? UINT_MAX : (unsigned int)ns;
+}
+
+/*************************************************
+ * Function: ws_compare
+ * Description: qsort comparator for wait samples
+ * Params: Two unsigned int pointers
+ * Returns: Negative, zero or positive like strcmp
+ * Pre-conditions: None
+ * Post-conditions: None
+ * **********************************************/
+int ws_compare(const void* a, const void* b)
+{
+	unsigned int x = *(const unsigned int*)a, y = *(const unsigned int*)b;
+	return (x > y) - (x < y);
+}
+
+/*************************************************
+ * Function: ws_percentile
+ * Description: Nearest rank percentile of the recorded waits
+ * Params: Wait_stats pointer, percentile between 0 and 100
+ * Returns: Wait in nanoseconds, 0 if there are no samples
+ * Pre-conditions: ws_sort has been called after the last ws_add
+ * Post-conditions: None
+ * **********************************************/
+unsigned int ws_percentile(Wait_stats* ws, double p)
+{
+	if(ws->count == 0)
+		return 0;
+	int rank = (int)(p / 100.0 * ws->count + 0.5);
+	if(rank < 1)
+		rank = 1;
+	if(rank > ws->count)
+		rank = ws->count;
+	return ws->ns[rank - 1];
+}
+
+/*************************************************
+ * Function: ws_sort
+ * Description: Sorts the samples so percentiles can be read
+ * Params: Wait_stats pointer
+ * Returns: None
+ * Pre-conditions: Nobody is still adding samples
+ * Post-conditions: Samples are in ascending order
+ * **********************************************/
+void ws_sort(Wait_stats* ws)
+{
+	qsort(ws->ns, ws->count, sizeof(unsigned int), ws_compare);
+}
+
+/*************************************************
+ * Function: ws_merge
+ * Description: Appends every sample of one thread's stats to another (for the per role rows)
+ * Params: Destination Wait_stats pointer, source Wait_stats pointer
+ * Returns: None
+ * Pre-conditions: Nobody is still adding samples to src
+ * Post-conditions: dst holds its old samples plus src's
+ * **********************************************/
+void ws_merge(Wait_stats* dst, Wait_stats* src)
+{
+	int i; for(i = 0; i < src->count; i++)
+		ws_add(dst, src->ns[i]);
+}
+
+/*************************************************
+ * Function: ws_free
+ * Description: Drops every sample
+ * Params: Wait_stats pointer
+ * Returns: None
+ * Pre-conditions: Nobody is still adding samples
+ * Post-conditions: Wait_stats is empty and may be reused
+ * **********************************************/
+void ws_free(Wait_stats* ws)
+{
+	free(ws->ns);
+	ws->ns = NULL;
+	ws->count = 0;
+	ws->capacity = 0;
+}
@@ -7,178 +7,514 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <time.h>
 #include <pthread.h>
 #include <semaphore.h>
+#include <sched.h>
+#include "waitqueue.h"
 
-//For a linked list of semaphores
-typedef struct Node {
-    sem_t *item;
-    struct Node* next;
-}Node;
+#define ARRIVAL_CAPACITY 64 //Arrivals that may wait for a free customer worker
+#define PARETO_SHAPE 2.5 //Tail index of heavy tailed times, finite variance but far more long ones than exponential
+
+//How the time between arrivals and the length of a haircut are drawn
+enum distributions {
+    DIST_FIXED, //Always the mean, like the original shop
+    DIST_EXP, //Exponential (Poisson arrivals), what M/M/c/K assumes
+    DIST_PARETO //Pareto with PARETO_SHAPE, scaled to the mean
+};
+
+const char* dist_names[] = { "fixed", "exp", "pareto" };
+#define NUM_DISTS (int)(sizeof(dist_names)/sizeof(dist_names[0]))
 
 //Thread arguments
 typedef struct Args_t {
-    sem_t* mutex, *customer, *customerDone, *barberDone, *speak;
-    Node* queue;
+    sem_t* mutex, *customer, *speak;
+    Wait_queue queue;
+    Slot* slots; //One per customer the shop holds, parked on while waiting and for the rendezvous with a barber
+    Slot* free_slots; //Slots nobody holds, linked through next (guarded by mutex). Slots left in the queue by customers
+                      //who gave up are only back here once a barber pops them, so more than n are allocated if needed.
+    int closing; //Set once every customer has left, barbers woken with an empty queue go home
     int* customers, *n, *total_customers;
+    int balked; //Customers who found the shop full (guarded by mutex)
+    int served;
+    int gave_up; //Customers who stopped waiting and left before a barber took them
+    double* gave_up_waits; //How long each of them waited
+    int gave_up_cap;
+    int waiting; //Customers in the queue, not yet taken by a barber (guarded by mutex like the rest below)
+    double last_change; //When customers or waiting last changed
+    double queue_area; //Integral of waiting over time
+    double shop_area; //Integral of customers over time
+    double wait_sum; //Time customers who got in spent in the queue, whether they were served or gave up
+    double stay_sum; //Time customers who got in spent in the shop
 }Args_t;
 
-//Function prototypes
-void insert(Node**, sem_t*);
-sem_t* pop_front(Node**);
+//Bounded ring of arrivals handed from main to the customer workers
+typedef struct Arrivals {
+    sem_t mutex, items, slots;
+    int ids[ARRIVAL_CAPACITY]; //Arrival numbers, 0 tells a worker to exit
+    double services[ARRIVAL_CAPACITY]; //Haircut length of each arrival
+    double patiences[ARRIVAL_CAPACITY]; //How long each arrival waits for a barber before leaving, 0 for ever
+    int head, tail;
+}Arrivals;
+
+//Arguments for customer worker threads
+typedef struct Worker_args {
+    Args_t* shop;
+    Arrivals* arrivals;
+}Worker_args;
+
+//Arguments and statistics of one barber thread
+typedef struct Barber_args {
+    Args_t* shop;
+    int id;
+    int served;
+    double busy; //Seconds spent cutting hair
+}Barber_args;
+
+int unit_us = 1000000; //Length of one simulated second in microseconds
+int quiet = 0; //1 to only print the summary
+double nap = 3; //Simulated seconds a barber naps after every haircut
+unsigned short seed[3]; //State of the random draws, only main draws
 
-void* t_customer(void*);
-void get_hair_cut(sem_t*, int);
+//Function prototypes
+void arrivals_init(Arrivals*);
+void arrivals_put(Arrivals*, int, double, double);
+int arrivals_take(Arrivals*, double*, double*);
+void* t_worker(void*);
+void t_customer(Args_t*, double, double);
+void get_hair_cut(sem_t*, int, double);
 void* t_barber(void*);
-void cut_hair(sem_t*);
+void cut_hair(sem_t*, int, double);
+void account(Args_t*);
+double draw(int, double);
+void mmck(double, double, double, int, int, double*);
+int compare_doubles(const void*, const void*);
+void summary_row(const char*, double, double, int);
 
 pthread_t* get_threads(int num_threads, void* function, void* args);
 void use_stdout(const char*, sem_t*, int);
+void barber_stdout(const char*, sem_t*, int);
+void pause_units(double);
+void pause_until(double);
+double now_s();
 
 int main(int argc, char** argv)
 {
+    int max_arrivals = 0; //0 to run forever
+    int num_barbers = 1;
+    double gap = 4; //Mean simulated seconds between arrivals
+    double service = 5; //Mean simulated seconds of a haircut
+    double patience = 0; //Mean simulated seconds a customer waits for a barber, 0 for ever
+    int arrival_dist = DIST_FIXED;
+    int service_dist = DIST_FIXED;
+    int patience_dist = DIST_FIXED;
+    long random_seed = time(NULL);
+    int opt, d;
+    while((opt = getopt(argc, argv, "b:a:g:u:qs:n:A:S:r:p:P:")) != -1)
+    {
+        if(opt == 'b' && atoi(optarg) >= 1)
+            num_barbers = atoi(optarg);
+        else if(opt == 'a' && atoi(optarg) >= 1)
+            max_arrivals = atoi(optarg);
+        else if(opt == 'g' && atof(optarg) >= 0)
+            gap = atof(optarg);
+        else if(opt == 'u' && atoi(optarg) >= 0)
+            unit_us = atoi(optarg);
+        else if(opt == 'q')
+            quiet = 1;
+        else if(opt == 's' && atof(optarg) > 0)
+            service = atof(optarg);
+        else if(opt == 'n' && atof(optarg) >= 0)
+            nap = atof(optarg);
+        else if(opt == 'r')
+            random_seed = atol(optarg);
+        else if(opt == 'p' && atof(optarg) >= 0)
+            patience = atof(optarg);
+        else if(opt == 'A' || opt == 'S' || opt == 'P')
+        {
+            for(d = 0; d < NUM_DISTS; d++)
+                if(strcmp(optarg, dist_names[d]) == 0)
+                    break;
+            if(d == NUM_DISTS)
+                opt = '?';
+            else if(opt == 'A')
+                arrival_dist = d;
+            else if(opt == 'S')
+                service_dist = d;
+            else
+                patience_dist = d;
+        }
+        else
+            opt = '?';
+
+        if(opt == '?')
+        {
+            printf("USAGE: main [-b BARBERS] [-a ARRIVALS] [-g GAP] [-s SERVICE] [-n NAP] [-A fixed|exp|pareto] [-S fixed|exp|pareto] [-p PATIENCE] [-P fixed|exp|pareto] [-r SEED] [-u UNIT_US] [-q] <NUM_CHAIRS>\n");
+            exit(1);
+        }
+    }
+
     //Check usage
-    if(argc < 2)
+    if(optind >= argc || atoi(argv[optind]) < 1)
     {
-        printf("USAGE: main <NUM_CHAIRS>\n");
+        printf("USAGE: main [-b BARBERS] [-a ARRIVALS] [-g GAP] [-s SERVICE] [-n NAP] [-A fixed|exp|pareto] [-S fixed|exp|pareto] [-p PATIENCE] [-P fixed|exp|pareto] [-r SEED] [-u UNIT_US] [-q] <NUM_CHAIRS>\n");
         exit(1);
     }
+    seed[0] = 0x330E; //Same layout srand48 uses
+    seed[1] = (unsigned short)random_seed;
+    seed[2] = (unsigned short)(random_seed >> 16);
 
     //Initialize variables
     int *n, *customers, *total_customers;
-    sem_t *mutex, *customer, *customerDone, *barberDone, *speak;
-    Node* queue = NULL;
+    sem_t *mutex, *customer, *speak;
 
     n = (int*)malloc(sizeof(int));
     customers = (int*)malloc(sizeof(int));
     total_customers = (int*)malloc(sizeof(int));
 
-    *n = atoi(argv[1]);
+    *n = atoi(argv[optind]);
     *customers = 0;
     *total_customers = 0;
 
     mutex = (sem_t*)malloc(sizeof(sem_t));
     customer = (sem_t*)malloc(sizeof(sem_t));
-    customerDone = (sem_t*)malloc(sizeof(sem_t));
-    barberDone = (sem_t*)malloc(sizeof(sem_t));
     speak = (sem_t*)malloc(sizeof(sem_t));
 
     sem_init(mutex, 0, 1);
     sem_init(customer, 0, 0);
-    sem_init(customerDone, 0, 0);
-    sem_init(barberDone, 0, 0);
     sem_init(speak, 0, 1);
 
     Args_t arguments;
     arguments.mutex = mutex;
     arguments.customer = customer;
-    arguments.customerDone = customerDone;
-    arguments.barberDone = barberDone;
     arguments.speak = speak;
-    arguments.queue = queue;
+    wq_init(&arguments.queue);
+    arguments.slots = (Slot*)malloc(sizeof(Slot)*(*n));
+    arguments.free_slots = NULL;
+    arguments.closing = 0;
+    int i; for(i = 0; i < *n; i++)
+    {
+        slot_init(&arguments.slots[i]);
+        arguments.slots[i].next = arguments.free_slots;
+        arguments.free_slots = &arguments.slots[i];
+    }
     arguments.customers = customers;
     arguments.n = n;
     arguments.total_customers = total_customers;
+    arguments.balked = 0;
+    arguments.served = 0;
+    arguments.gave_up = 0;
+    arguments.gave_up_cap = 1024;
+    arguments.gave_up_waits = (double*)malloc(sizeof(double)*arguments.gave_up_cap);
+    arguments.waiting = 0;
+    arguments.queue_area = 0;
+    arguments.shop_area = 0;
+    arguments.wait_sum = 0;
+    arguments.stay_sum = 0;
+
+    //Create barber threads, all serving the one waiting queue
+    Barber_args* b_args = (Barber_args*)malloc(sizeof(Barber_args)*num_barbers);
+    pthread_t* barbers = (pthread_t*)malloc(sizeof(pthread_t)*num_barbers);
+    for(i = 0; i < num_barbers; i++)
+    {
+        b_args[i].shop = &arguments;
+        b_args[i].id = i + 1;
+        b_args[i].served = 0;
+        b_args[i].busy = 0;
+        pthread_create(&barbers[i], NULL, t_barber, &b_args[i]);
+    }
 
-    //Create barber thread
-    pthread_t b_thread;
-    pthread_create(&b_thread, NULL, t_barber, &arguments);
+    //Customers are played by a fixed pool of workers instead of a thread each. At most n customers are in the shop,
+    //each holding a worker, so one more worker is always free to turn the next arrival away when the shop is full.
+    Arrivals arrivals;
+    arrivals_init(&arrivals);
+    int num_workers = *n + 1;
+    Worker_args* w_args = (Worker_args*)malloc(sizeof(Worker_args)*num_workers);
+    pthread_t* workers = (pthread_t*)malloc(sizeof(pthread_t)*num_workers);
+    for(i = 0; i < num_workers; i++)
+    {
+        w_args[i].shop = &arguments;
+        w_args[i].arrivals = &arrivals;
+        pthread_create(&workers[i], NULL, t_worker, &w_args[i]);
+    }
 
-    //Send a new customer in every 4 seconds
-    pthread_t c_thread;
-    while(1)
+    //Send new customers in with gaps drawn around the mean. Arrival times are kept against the clock rather than by
+    //sleeping each gap, so oversleeping one gap does not slow the arrival rate down.
+    double start = now_s();
+    double next = start;
+    arguments.last_change = start;
+    int arrival;
+    for(arrival = 1; max_arrivals == 0 || arrival <= max_arrivals; arrival++)
     {
-        pthread_create(&c_thread, NULL, t_customer, &arguments);
-        sleep(4);
+        arrivals_put(&arrivals, arrival, draw(service_dist, service), patience > 0 ? draw(patience_dist, patience) : 0);
+        next += draw(arrival_dist, gap) * unit_us / 1e6;
+        pause_until(next);
     }
+
+    //Let every worker finish its customer, then the barbers
+    for(i = 0; i < num_workers; i++)
+        arrivals_put(&arrivals, 0, 0, 0);
+    for(i = 0; i < num_workers; i++)
+        pthread_join(workers[i], NULL);
+    __atomic_store_n(&arguments.closing, 1, __ATOMIC_RELAXED);
+    for(i = 0; i < num_barbers; i++)
+        sem_post(customer); //Empty queue tells a barber to go home
+    for(i = 0; i < num_barbers; i++)
+        pthread_join(barbers[i], NULL);
+    account(&arguments);
+    double elapsed = now_s() - start;
+
+    printf("Arrivals: %d\tServed: %d\tBalked: %d\tGave up: %d\tBarbers: %d\tCustomer workers: %d\tElapsed: %.2f s (%.0f arrivals/s)\n",
+        max_arrivals, arguments.served, arguments.balked, arguments.gave_up, num_barbers, num_workers, elapsed, max_arrivals / elapsed);
+    double busy = 0;
+    for(i = 0; i < num_barbers; i++)
+    {
+        printf("Barber %d: served %d\tbusy %.2f s\tutilization %.1f%%\n", b_args[i].id, b_args[i].served, b_args[i].busy,
+            100.0 * b_args[i].busy / elapsed);
+        busy += b_args[i].busy;
+    }
+
+    //Measured against what M/M/c/K (with exponential patience M/M/c/K+M) predicts for the same means, c barbers and K = NUM_CHAIRS
+    double model[7];
+    if(gap > 0)
+        mmck(1 / gap, 1 / service, patience > 0 ? 1 / patience : 0, num_barbers, *n, model);
+    else
+    {
+        for(i = 0; i < 7; i++)
+            model[i] = -1; //Back to back arrivals have no finite rate to model
+    }
+    //Idle barbers all take turns at the queue, but with at most NUM_CHAIRS customers in the shop no more than that many cut
+    //hair at once. Utilization is total busy time over the barbers that can be busy together, like mmck's capped c.
+    int seated = num_barbers < *n ? num_barbers : *n;
+    double unit_s = unit_us / 1e6;
+    int got_in = arguments.served + arguments.gave_up > 0 ? arguments.served + arguments.gave_up : 1;
+    printf("\nArrivals %s (mean %.2f), haircuts %s (mean %.2f), nap %.2f", dist_names[arrival_dist], gap, dist_names[service_dist],
+        service, nap);
+    if(patience > 0)
+        printf(", patience %s (mean %.2f)", dist_names[patience_dist], patience);
+    printf("\n%-24s %10s %10s\n", "", "measured", "M/M/c/K");
+    summary_row("Balk rate", (double)arguments.balked / max_arrivals, model[0], 1);
+    if(patience > 0)
+        summary_row("Gave up rate", (double)arguments.gave_up / max_arrivals, model[1], 1);
+    summary_row("Mean queue length", arguments.queue_area / elapsed, model[2], 0);
+    summary_row("Mean customers in shop", arguments.shop_area / elapsed, model[3], 0);
+    if(unit_us > 0)
+    {
+        summary_row("Mean wait (s)", arguments.wait_sum / got_in / unit_s, model[4], 0);
+        summary_row("Mean time in shop (s)", arguments.stay_sum / got_in / unit_s, model[5], 0);
+    }
+    summary_row("Barber utilization", busy / (elapsed * seated), model[6], 1);
+    if(gap > 0 && (arrival_dist != DIST_EXP || service_dist != DIST_EXP || nap > 0 || (patience > 0 && patience_dist != DIST_EXP)))
+        printf("(M/M/c/K is exact only for -A exp -S exp -n 0 and -P exp or no -p, otherwise it is a reference point)\n");
+
+    //Distribution of how long customers who gave up had waited
+    if(arguments.gave_up > 0 && unit_us > 0)
+    {
+        double* waits = arguments.gave_up_waits;
+        int count = arguments.gave_up;
+        qsort(waits, count, sizeof(double), compare_doubles);
+        double sum = 0;
+        for(i = 0; i < count; i++)
+            sum += waits[i];
+        printf("\n%-26s %10s %10s %10s %10s %10s\n", "Gave up after waiting (s)", "mean", "p50", "p90", "p99", "max");
+        printf("%-26s %10.3f %10.3f %10.3f %10.3f %10.3f\n", "", sum / count / unit_s, waits[(int)(count * 0.50)] / unit_s,
+            waits[(int)(count * 0.90)] / unit_s, waits[(int)(count * 0.99)] / unit_s, waits[count - 1] / unit_s);
+    }
+    free(workers);
+    free(w_args);
+    free(barbers);
+    free(b_args);
+    //Slots allocated on top of the first n are freed one by one, every slot is back on the free list by now
+    Slot* slot = arguments.free_slots;
+    while(slot != NULL)
+    {
+        Slot* next = slot->next;
+        if(slot < arguments.slots || slot >= arguments.slots + *n)
+            free(slot);
+        slot = next;
+    }
+    free(arguments.slots);
+    free(arguments.gave_up_waits);
+    sem_destroy(&arrivals.mutex);
+    sem_destroy(&arrivals.items);
+    sem_destroy(&arrivals.slots);
+    sem_destroy(mutex);
+    sem_destroy(customer);
+    sem_destroy(speak);
+    free(mutex);
+    free(customer);
+    free(speak);
+    free(n);
+    free(customers);
+    free(total_customers);
     return 0;
 }
 
 /*************************************************
- * Function: insert
- * Description: Recursively insert a node at the end of the linked list
- * Params: Address to a node pointer (If we need to update the head), Address of semaphore we want to add
+ * Function: arrivals_init
+ * Description: Sets up an empty arrival ring
+ * Params: Arrivals pointer
  * Returns: None
- * Pre-conditions: None 
- * Post-conditions: Node has been added to the end of the linked list with allocated memory or head has been added
+ * Pre-conditions: None
+ * Post-conditions: Ring is empty with ARRIVAL_CAPACITY free slots
  * **********************************************/
-void insert(Node** node, sem_t *sem)
+void arrivals_init(Arrivals* ring)
 {
-    if((*node) == NULL)
-    {
-        (*node) = (Node*)malloc(sizeof(Node));
-        (*node)->next = NULL;
-        (*node)->item = sem;
-        return;
-    }
-    insert(&((*node)->next), sem);
+    sem_init(&ring->mutex, 0, 1);
+    sem_init(&ring->items, 0, 0);
+    sem_init(&ring->slots, 0, ARRIVAL_CAPACITY);
+    ring->head = 0;
+    ring->tail = 0;
 }
 
 /*************************************************
- * Function: pop_front
- * Description: Removes a node from the head of the linked list and returns the address of the semaphore associated with it
- * Params: Address to head pointer.
- * Returns: Address of the semaphore in the head node.
- * Pre-conditions: List should have at least one node in it otherwise this returns NULL as an error
- * Post-conditions: Address of semaphore or NULL has been returned.
+ * Function: arrivals_put
+ * Description: Hands an arrival to the customer workers, waiting while the ring is full
+ * Params: Arrivals pointer, arrival number (0 to stop a worker), its haircut length and patience
+ * Returns: None
+ * Pre-conditions: Ring is initialized
+ * Post-conditions: A worker will take the arrival
  * **********************************************/
-sem_t* pop_front(Node** node)
+void arrivals_put(Arrivals* ring, int id, double service, double patience)
 {
-    if((*node) == NULL)
-    {
-        return NULL;
-    }
-    sem_t* poped_sem = (*node)->item;
+    sem_wait(&ring->slots);
+    sem_wait(&ring->mutex);
+    ring->ids[ring->tail] = id;
+    ring->services[ring->tail] = service;
+    ring->patiences[ring->tail] = patience;
+    ring->tail = (ring->tail + 1) % ARRIVAL_CAPACITY;
+    sem_post(&ring->mutex);
+    sem_post(&ring->items);
+}
 
-    Node* temp = *node;
-    *node = (*node)->next;
-    free(temp);
+/*************************************************
+ * Function: arrivals_take
+ * Description: Takes the oldest arrival, waiting while there is none
+ * Params: Arrivals pointer, where to store its haircut length and patience
+ * Returns: Arrival number, 0 if the worker should exit
+ * Pre-conditions: Ring is initialized
+ * Post-conditions: Arrival is out of the ring
+ * **********************************************/
+int arrivals_take(Arrivals* ring, double* service, double* patience)
+{
+    sem_wait(&ring->items);
+    sem_wait(&ring->mutex);
+    int id = ring->ids[ring->head];
+    *service = ring->services[ring->head];
+    *patience = ring->patiences[ring->head];
+    ring->head = (ring->head + 1) % ARRIVAL_CAPACITY;
+    sem_post(&ring->mutex);
+    sem_post(&ring->slots);
+    return id;
+}
 
-    return poped_sem;
+/*************************************************
+ * Function: t_worker
+ * Description: Customer worker thread function. Plays one arriving customer after the other until told to stop.
+ * Params: Worker_args struct
+ * Returns: None
+ * Pre-conditions: Worker_args struct has been initialized and filled with values
+ * Post-conditions: Worker's last customer has left the shop
+ * **********************************************/
+void* t_worker(void* args)
+{
+    Worker_args* w_args = (Worker_args*)args;
+    double service, patience;
+    while(arrivals_take(w_args->arrivals, &service, &patience) != 0)
+        t_customer(w_args->shop, service, patience);
+    return NULL;
 }
 
 /*************************************************
  * Function: t_customer
- * Description: Customer thread function. Enters barbershop if it is not full and waits in line to get a haircut.
- * Params: Args_t struct for semaphores, queue and counters
+ * Description: One customer, played by a customer worker. Enters barbershop if it is not full and waits in line to get a haircut,
+ * or until it runs out of patience.
+ * Params: Args_t struct for semaphores, queue and counters, length of the haircut, simulated seconds it waits (0 for ever)
  * Returns: None
  * Pre-conditions: Args_t struct has been initialized and filled with values. 
- * Post-conditions: Customer has left shop if full or left shop after getting a haircut
+ * Post-conditions: Customer has left shop if full, after waiting too long or after getting a haircut
  * **********************************************/
-void* t_customer(void* args)
+void t_customer(Args_t* c_args, double service, double patience)
 {
-    //Get arguments and create a semaphore exclusive to this customer thread
-    Args_t* c_args = (Args_t*)args;
-    sem_t* self_sem = (sem_t*)malloc(sizeof(sem_t));
-    sem_init(self_sem, 0, 0);
-
     //Wait for exclusive access to resources
     sem_wait(c_args->mutex);
     if(*(c_args->customers) == *(c_args->n)) //If the number of customers is equal to the number of chairs
     {
+        c_args->balked += 1;
         sem_post(c_args->mutex); //Give up exclusive access and leave barbershop
         use_stdout("[C-FULL]Barbershop is full, customer leaving.\n", c_args->speak, 0);
         return;
     }
 
+    account(c_args);
     *(c_args->customers) += 1; //Update number of customers and customer count
     *(c_args->total_customers) += 1;
+    c_args->waiting += 1;
     int customer_id = *(c_args->total_customers);
+    Slot* slot = c_args->free_slots;
+    if(slot == NULL)
+    {
+        slot = (Slot*)malloc(sizeof(Slot)); //The first n are all in the queue, some left there by customers who gave up
+        slot_init(slot);
+    }
+    else
+        c_args->free_slots = slot->next;
+    slot->service = service;
+    double arrived = now_s();
 
     use_stdout("[C-WAIT] Customer is waiting in lobby.\n", c_args->speak, customer_id);
-    insert(&(c_args->queue), self_sem); //Insert this customer into the queue
     sem_post(c_args->mutex); //Give up exclusive access
+    wq_push(&(c_args->queue), slot); //Insert this customer into the queue, no lock needed
 
     sem_post(c_args->customer);
-    sem_wait(self_sem); //Wait until this thread has been signaled for a haircut by the barber
+    if(patience == 0)
+        park(&slot->turn); //Wait until this thread has been signaled for a haircut by a barber
+    else
+    {
+        struct timespec deadline;
+        double t = arrived + patience * unit_us / 1e6;
+        deadline.tv_sec = (time_t)t;
+        deadline.tv_nsec = (long)((t - deadline.tv_sec) * 1e9);
+        if(!park_until(&slot->turn, &deadline))
+        {
+            //No barber will take this slot now. The one that pops it drops it, so it is not ours to give back.
+            double waited = now_s() - arrived;
+            sem_wait(c_args->mutex);
+            account(c_args);
+            *(c_args->customers) -= 1;
+            c_args->waiting -= 1;
+            c_args->wait_sum += waited;
+            c_args->stay_sum += waited;
+            if(c_args->gave_up == c_args->gave_up_cap)
+            {
+                c_args->gave_up_cap *= 2;
+                c_args->gave_up_waits = (double*)realloc(c_args->gave_up_waits, sizeof(double)*c_args->gave_up_cap);
+            }
+            c_args->gave_up_waits[c_args->gave_up++] = waited;
+            use_stdout("[C-GIVEUP] Customer waited too long and left the barbershop.\n", c_args->speak, customer_id);
+            sem_post(c_args->mutex);
+            return;
+        }
+    }
+    double waited = now_s() - arrived;
 
-    get_hair_cut(c_args->speak, customer_id); //Get a hair cut
+    get_hair_cut(c_args->speak, customer_id, service); //Get a hair cut
 
-    sem_post(c_args->customerDone);
-    sem_wait(c_args->barberDone);
+    //Rendezvous with the barber holding this slot only, other barbers finishing at the same time use their own customer's
+    unpark(&slot->customer_done);
+    park(&slot->barber_done);
 
     sem_wait(c_args->mutex);
+    account(c_args);
     *(c_args->customers) -= 1; //Decrement number of customers currently waiting
+    c_args->served += 1;
+    c_args->wait_sum += waited;
+    c_args->stay_sum += now_s() - arrived;
+    slot->next = c_args->free_slots;
+    c_args->free_slots = slot;
     use_stdout("[C-LEAVE] Customer has left the barbershop.\n", c_args->speak, customer_id);
     sem_post(c_args->mutex);
 
@@ -187,64 +523,210 @@ void* t_customer(void* args)
 
 /*************************************************
  * Function: get_hair_cut
- * Description: Sleeps for 5 seconds and tells grader.
- * Params: Speaking semaphore, customer id
+ * Description: Sleeps for the length of the haircut and tells grader.
+ * Params: Speaking semaphore, customer id, simulated seconds
  * Returns: None
  * Pre-conditions: None 
  * Post-conditions: None
  * **********************************************/
-void get_hair_cut(sem_t* speak, int id)
+void get_hair_cut(sem_t* speak, int id, double service)
 {
-    use_stdout("[C-HAIRCUT] Customer is getting a haircut for 5 seconds.\n", speak, id);
-    sleep(5);
+    char msg[80];
+    snprintf(msg, sizeof(msg), "[C-HAIRCUT] Customer is getting a haircut for %.1f seconds.\n", service);
+    use_stdout(msg, speak, id);
+    pause_units(service);
 }
 
 /*************************************************
  * Function: t_barber
- * Description: Gives customers haircuts and signals them for a haircut in the order that they arrive in the waiting room
- * Params: Args_t struct for semaphores, queue and counters
+ * Description: Gives customers haircuts and signals them for a haircut in the order that they arrive in the waiting room. Every barber takes
+ * the next customer from the same queue whenever it is free.
+ * Params: Barber_args struct for the shop, the barber's number and its statistics
  * Returns: None
  * Pre-conditions: Args_t struct has been initialized, memory allocated and values set
- * Post-conditions: None, never exits.
+ * Post-conditions: Exits once woken up with nobody in the queue
  * **********************************************/
 void* t_barber(void* args)
 {
     //Initialize arguments
-    Args_t* b_args = (Args_t*)args;
-    sem_t* c_sem;
+    Barber_args* barber = (Barber_args*)args;
+    Args_t* b_args = barber->shop;
+    Slot* slot;
+    int dropped;
 
     while(1)
     {
         sem_wait(b_args->customer); //Wait for a customer
-        sem_wait(b_args->mutex); //Get exclusive resource access
-        c_sem = pop_front(&(b_args->queue)); //Get the first customer in the queue
-        sem_post(b_args->mutex); //Give up exclusive access
-
-        sem_post(c_sem);
-
-        cut_hair(b_args->speak); //Cut hair
-        use_stdout("[B-DONE] Barber is done cutting customer's hair.\n", b_args->speak, 0);
-
-        sem_wait(b_args->customerDone);
-        sem_post(b_args->barberDone);
-        use_stdout("[B-SLEEP] Barber is taking a 3 second nap.\n", b_args->speak, 0); //Take a 3 second nap
-        sleep(3);
+        while(1)
+        {
+            sem_wait(b_args->mutex); //Barbers pop one at a time
+            slot = wq_pop(&(b_args->queue)); //Get the first customer in the queue
+            dropped = 0;
+            if(slot != NULL && claim(&slot->turn)) //Tells the customer its haircut starts, unless it already gave up
+            {
+                account(b_args);
+                b_args->waiting -= 1;
+            }
+            else if(slot != NULL)
+            {
+                slot_init(slot); //Its customer left it behind, nobody else touches it any more
+                slot->next = b_args->free_slots;
+                b_args->free_slots = slot;
+                dropped = 1;
+            }
+            sem_post(b_args->mutex);
+            if(slot != NULL || __atomic_load_n(&b_args->closing, __ATOMIC_RELAXED))
+                break;
+            sched_yield(); //A customer is halfway through joining the queue
+        }
+        if(dropped)
+            continue; //Its customer's post is used up, wait for the next one
+        if(slot == NULL)
+            break; //Shop is closing
+
+        double start = now_s();
+        cut_hair(b_args->speak, barber->id, slot->service); //Cut hair
+        barber->busy += now_s() - start;
+        barber->served += 1;
+        barber_stdout("[B-DONE] Barber is done cutting customer's hair.\n", b_args->speak, barber->id);
+
+        park(&slot->customer_done);
+        unpark(&slot->barber_done);
+        if(nap > 0)
+        {
+            char msg[80];
+            snprintf(msg, sizeof(msg), "[B-SLEEP] Barber is taking a %.1f second nap.\n", nap);
+            barber_stdout(msg, b_args->speak, barber->id); //Take a nap
+            pause_units(nap);
+        }
     }
-    return;
+    return NULL;
 }
 
 /*************************************************
  * Function: cut_hair
- * Description: Informs grader that the barber is cutting hair and sleeps for 5 seconds (same duration as get_hair_cut)
- * Params: Speak semaphore
+ * Description: Informs grader that the barber is cutting hair and sleeps for the length of the haircut (same duration as get_hair_cut)
+ * Params: Speak semaphore, barber number, simulated seconds
  * Returns: none
  * Pre-conditions: none
  * Post-conditions: none
  * **********************************************/
-void cut_hair(sem_t* speak)
+void cut_hair(sem_t* speak, int barber, double service)
+{
+    char msg[80];
+    snprintf(msg, sizeof(msg), "[B-CUT] Barber is cutting customer's hair for %.1f seconds.\n", service);
+    barber_stdout(msg, speak, barber);
+    pause_units(service);
+}
+
+/*************************************************
+ * Function: account
+ * Description: Adds the time since the last change times the current queue length and customer count to their integrals
+ * Params: Args_t struct
+ * Returns: None
+ * Pre-conditions: Caller holds the shop mutex and is about to change waiting or customers
+ * Post-conditions: Integrals are up to now
+ * **********************************************/
+void account(Args_t* shop)
 {
-    use_stdout("[B-CUT] Barber is cutting customer's hair for 5 seconds.\n", speak, 0);
-    sleep(5);
+    double now = now_s();
+    shop->queue_area += shop->waiting * (now - shop->last_change);
+    shop->shop_area += *(shop->customers) * (now - shop->last_change);
+    shop->last_change = now;
+}
+
+/*************************************************
+ * Function: summary_row
+ * Description: Prints one row of the summary, a measured value next to the model's
+ * Params: Label, measured value, predicted value (negative if there is none), 1 to print both as percentages
+ * Returns: None
+ * Pre-conditions: None
+ * Post-conditions: None
+ * **********************************************/
+void summary_row(const char* label, double measured, double predicted, int percent)
+{
+    char cell[16];
+    if(predicted < 0)
+        snprintf(cell, sizeof(cell), "n/a");
+    else if(percent)
+        snprintf(cell, sizeof(cell), "%.2f%%", 100 * predicted);
+    else
+        snprintf(cell, sizeof(cell), "%.3f", predicted);
+
+    if(percent)
+        printf("%-24s %9.2f%% %10s\n", label, 100 * measured, cell);
+    else
+        printf("%-24s %10.3f %10s\n", label, measured, cell);
+}
+
+/*************************************************
+ * Function: compare_doubles
+ * Description: qsort comparison for ascending doubles
+ * Params: Pointers to two doubles
+ * Returns: Negative, zero or positive as the first is smaller, equal or larger
+ * Pre-conditions: None
+ * Post-conditions: None
+ * **********************************************/
+int compare_doubles(const void* a, const void* b)
+{
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+/*************************************************
+ * Function: draw
+ * Description: Draws a random time from a distribution
+ * Params: Distribution (distributions value), mean
+ * Returns: Time in simulated seconds, the mean over many draws is mean
+ * Pre-conditions: Only main draws (seed is not shared safely)
+ * Post-conditions: None
+ * **********************************************/
+double draw(int dist, double mean)
+{
+    double u = erand48(seed); //In [0, 1)
+    if(dist == DIST_EXP)
+        return -mean * log(1 - u);
+    if(dist == DIST_PARETO)
+        return mean * (PARETO_SHAPE - 1) / PARETO_SHAPE * pow(1 - u, -1 / PARETO_SHAPE);
+    return mean;
+}
+
+/*************************************************
+ * Function: mmck
+ * Description: Steady state of the M/M/c/K+M queue: Poisson arrivals, exponential haircuts, c barbers, room for K customers
+ * counting the ones in barber chairs (arrivals finding K customers balk) and exponential patience of waiting customers
+ * Params: Arrival rate, service rate of one barber, rate at which a waiting customer gives up (0 for M/M/c/K), barbers,
+ * capacity, array of 7 results: balk probability, give up probability, mean queue length, mean customers in shop, mean
+ * wait in queue and mean time in shop of customers who got in, barber utilization
+ * Returns: None
+ * Pre-conditions: Arrival and service rates are positive
+ * Post-conditions: Results are filled in
+ * **********************************************/
+void mmck(double lambda, double mu, double theta, int c, int k, double* out)
+{
+    if(c > k)
+        c = k; //At most k customers are in the shop, so at most k barbers are cutting hair at any moment
+    double term = 1, total = 0, in_shop = 0, queued = 0;
+    int j; for(j = 0; j <= k; j++)
+    {
+        //term is P(j customers) / P(0). Customers leave a shop of j at the rate of the busy barbers plus the waiting ones giving up.
+        if(j > 0)
+            term *= lambda / ((j < c ? j : c) * mu + (j > c ? j - c : 0) * theta);
+        total += term;
+        in_shop += j * term;
+        if(j > c)
+            queued += (j - c) * term;
+    }
+    double balk = term / total;
+    double accepted = lambda * (1 - balk);
+    double leaving = theta * queued / total; //Rate of customers giving up
+    out[0] = balk;
+    out[1] = leaving / lambda;
+    out[2] = queued / total;
+    out[3] = in_shop / total;
+    out[4] = out[2] / accepted;
+    out[5] = out[3] / accepted;
+    out[6] = (accepted - leaving) / (c * mu);
 }
 
 /*************************************************
@@ -275,10 +757,76 @@ pthread_t* get_threads(int num_threads, void* function, void* args)
  * **********************************************/
 void use_stdout(const char* msg, sem_t* sem, int id)
 {
+    if(quiet)
+        return;
     sem_wait(sem);
     if(id == 0)
         printf(msg);
     else
         printf("[C-#%d]---%s", id, msg);
     sem_post(sem);
+}
+/*************************************************
+ * Function: barber_stdout
+ * Description: Grants exclusive access to stdout and prints a message to the screen with the number of the barber speaking
+ * Params: Message, speaking semaphore, barber number
+ * Returns: None
+ * Pre-conditions: Speaking semaphore is set up
+ * Post-conditions: None
+ * **********************************************/
+void barber_stdout(const char* msg, sem_t* sem, int barber)
+{
+    if(quiet)
+        return;
+    sem_wait(sem);
+    printf("[B-#%d]---%s", barber, msg);
+    sem_post(sem);
+}
+
+/*************************************************
+ * Function: pause_units
+ * Description: Sleeps for a number of simulated seconds (unit_us microseconds each)
+ * Params: Simulated seconds
+ * Returns: None
+ * Pre-conditions: None
+ * Post-conditions: None
+ * **********************************************/
+void pause_units(double units)
+{
+    long long us = (long long)(units * unit_us);
+    struct timespec ts;
+    ts.tv_sec = us / 1000000;
+    ts.tv_nsec = us % 1000000 * 1000L;
+    nanosleep(&ts, NULL);
+}
+
+/*************************************************
+ * Function: pause_until
+ * Description: Sleeps until the monotonic clock reaches a time
+ * Params: Time as now_s reads it
+ * Returns: None
+ * Pre-conditions: None
+ * Post-conditions: None
+ * **********************************************/
+void pause_until(double t)
+{
+    struct timespec ts;
+    ts.tv_sec = (time_t)t;
+    ts.tv_nsec = (long)((t - ts.tv_sec) * 1e9);
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+}
+
+/*************************************************
+ * Function: now_s
+ * Description: Reads the monotonic clock
+ * Params: None
+ * Returns: Seconds since an arbitrary fixed point
+ * Pre-conditions: None
+ * Post-conditions: None
+ * **********************************************/
+double now_s()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
 }
\ No newline at end of file
@@ -0,0 +1,209 @@
+#pragma once
+
+//////////////////////////////////////////////////////
+// Waiting room queue and per customer parking.
+//
+// Every customer in the shop holds a slot, which is both its queue node (the link is inside the
+// slot, nothing is allocated per customer) and the place it parks while it waits for a barber.
+//
+// The queue is an intrusive multi producer, single consumer list (Vyukov): a stub node keeps it
+// from ever being empty, producers append with one atomic exchange of the head and then link the
+// old head to their slot, and the consumer walks from the tail. A producer that has exchanged but
+// not linked yet makes the consumer see the queue as empty for a moment, so the consumer retries.
+// Several barbers pop one at a time under a lock, which keeps the consumer side single.
+//
+// Parking words hold 0 (not posted), 1 (posted) or 2 (owner asleep on the futex), so a post only
+// makes the wake system call when the owner is actually asleep.
+//
+// A customer that runs out of patience can not take its slot out of the middle of the queue, since
+// producers may be linking onto it and the consumer walking past it. Instead it moves its turn word
+// to GAVE_UP with the same compare and swap a barber uses to post it, so exactly one of them wins:
+// either the barber claims the customer, or the customer leaves and the barber that pops the slot
+// later drops it.
+//////////////////////////////////////////////////////
+
+#include <stddef.h>
+#include "futex.h"
+
+#define GAVE_UP 3 //Turn word of a customer that stopped waiting
+
+typedef struct Slot {
+    struct Slot* next; //Queue link
+    int turn; //Barber to customer: your haircut starts
+    int customer_done;
+    int barber_done;
+    double service; //Length of its haircut, set before it is pushed
+}Slot;
+
+typedef struct Wait_queue {
+    Slot* head; //Last slot pushed, exchanged by producers
+    Slot* tail; //Next slot to pop, consumer only
+    Slot stub;
+}Wait_queue;
+
+/*************************************************
+ * Function: wq_init
+ * Description: Sets up an empty queue
+ * Params: Wait_queue pointer
+ * Returns: None
+ * Pre-conditions: None
+ * Post-conditions: Head and tail are the stub
+ * **********************************************/
+void wq_init(Wait_queue* q)
+{
+    q->stub.next = NULL;
+    q->head = &q->stub;
+    q->tail = &q->stub;
+}
+
+/*************************************************
+ * Function: wq_push
+ * Description: Appends a slot with one atomic exchange, never waits
+ * Params: Wait_queue pointer, slot
+ * Returns: None
+ * Pre-conditions: Slot is not in the queue
+ * Post-conditions: Slot is at the end of the queue
+ * **********************************************/
+void wq_push(Wait_queue* q, Slot* slot)
+{
+    __atomic_store_n(&slot->next, NULL, __ATOMIC_RELAXED);
+    Slot* prev = __atomic_exchange_n(&q->head, slot, __ATOMIC_ACQ_REL);
+    __atomic_store_n(&prev->next, slot, __ATOMIC_RELEASE); //Until here the consumer can not get past prev
+}
+
+/*************************************************
+ * Function: wq_pop
+ * Description: Takes the oldest slot
+ * Params: Wait_queue pointer
+ * Returns: Oldest slot, NULL if the queue is empty or a push is halfway done (try again)
+ * Pre-conditions: Only one thread pops at a time
+ * Post-conditions: Slot is out of the queue
+ * **********************************************/
+Slot* wq_pop(Wait_queue* q)
+{
+    Slot* tail = q->tail;
+    Slot* next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+    if(tail == &q->stub)
+    {
+        if(next == NULL)
+            return NULL;
+        q->tail = next; //Skip the stub
+        tail = next;
+        next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+    }
+    if(next != NULL)
+    {
+        q->tail = next;
+        return tail;
+    }
+    if(tail != __atomic_load_n(&q->head, __ATOMIC_ACQUIRE))
+        return NULL; //Somebody exchanged the head but has not linked tail to it yet
+
+    //tail is the last slot, put the stub behind it so it can be taken out
+    wq_push(q, &q->stub);
+    next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+    if(next != NULL)
+    {
+        q->tail = next;
+        return tail;
+    }
+    return NULL;
+}
+
+/*************************************************
+ * Function: slot_init
+ * Description: Clears every parking word of a slot
+ * Params: Slot pointer
+ * Returns: None
+ * Pre-conditions: Nobody is parked on the slot
+ * Post-conditions: Nothing is posted
+ * **********************************************/
+void slot_init(Slot* slot)
+{
+    slot->next = NULL;
+    slot->turn = 0;
+    slot->customer_done = 0;
+    slot->barber_done = 0;
+}
+
+/*************************************************
+ * Function: park
+ * Description: Waits until the word is posted, sleeping on a futex if it is not yet, and consumes the post
+ * Params: Parking word
+ * Returns: None
+ * Pre-conditions: Only the calling thread parks on the word
+ * Post-conditions: Word is back to 0
+ * **********************************************/
+void park(int* word)
+{
+    int expected = 0;
+    if(__atomic_compare_exchange_n(word, &expected, 2, 0, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE))
+    {
+        while(__atomic_load_n(word, __ATOMIC_ACQUIRE) == 2)
+            futex_wait(word, 2);
+    }
+    __atomic_store_n(word, 0, __ATOMIC_RELAXED);
+}
+
+/*************************************************
+ * Function: park_until
+ * Description: Like park, but gives up at a deadline unless the word is posted first
+ * Params: Parking word, deadline on the CLOCK_MONOTONIC clock
+ * Returns: 1 if the post was consumed, 0 if the caller gave up (the word is left GAVE_UP)
+ * Pre-conditions: Only the calling thread parks on the word, posters use claim
+ * Post-conditions: Word is back to 0, or GAVE_UP and no poster will post it
+ * **********************************************/
+int park_until(int* word, const struct timespec* deadline)
+{
+    int expected = 0;
+    if(__atomic_compare_exchange_n(word, &expected, 2, 0, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE))
+    {
+        while(__atomic_load_n(word, __ATOMIC_ACQUIRE) == 2)
+        {
+            if(futex_wait_until(word, 2, deadline))
+                continue;
+            expected = 2;
+            if(__atomic_compare_exchange_n(word, &expected, GAVE_UP, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+                return 0;
+        }
+    }
+    __atomic_store_n(word, 0, __ATOMIC_RELAXED);
+    return 1;
+}
+
+/*************************************************
+ * Function: claim
+ * Description: Posts a word unless its owner gave up, waking the owner if it is asleep
+ * Params: Parking word
+ * Returns: 1 if posted, 0 if the owner gave up
+ * Pre-conditions: Word is not posted already
+ * Post-conditions: Owner's park or park_until returns 1, or the owner is gone
+ * **********************************************/
+int claim(int* word)
+{
+    int seen = __atomic_load_n(word, __ATOMIC_ACQUIRE);
+    while(seen != GAVE_UP)
+    {
+        if(__atomic_compare_exchange_n(word, &seen, 1, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+        {
+            if(seen == 2)
+                futex_wake(word, 1);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*************************************************
+ * Function: unpark
+ * Description: Posts the word, waking its owner if it is asleep
+ * Params: Parking word
+ * Returns: None
+ * Pre-conditions: Word is not posted already
+ * Post-conditions: Owner's park returns
+ * **********************************************/
+void unpark(int* word)
+{
+    if(__atomic_exchange_n(word, 1, __ATOMIC_RELEASE) == 2)
+        futex_wake(word, 1);
+}